@@ -0,0 +1,400 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KIconThemes authors, see the git history
+
+    The reference implementations of the effects are taken from kiconeffect.cpp:
+    SPDX-FileCopyrightText: 2000 Geert Jansen <jansen@kde.org>
+    SPDX-FileCopyrightText: 2007 Daniel M. Duley <daniel.duley@verizon.net>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#include <kiconeffect.h>
+
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTest>
+#include <QThreadPool>
+
+#include <array>
+
+#include <math.h>
+
+extern KICONTHEMES_EXPORT int kiconeffect_kernel_set;
+extern KICONTHEMES_EXPORT QList<QByteArray> kiconeffect_kernel_sets();
+
+/*
+ * Run with "-o results.csv,csv" (or the kiconeffect_benchmark_results target)
+ * to get the results in a form that can be compared between runs.
+ */
+class KIconEffect_Benchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QImage randomImage(int size, QImage::Format format = QImage::Format_ARGB32)
+    {
+        QRandomGenerator generator(size);
+        if (format == QImage::Format_Indexed8) {
+            // Few enough colors that overlay() can merge the tables of two images
+            QImage image(size, size, format);
+            QList<QRgb> colors(100);
+            for (QRgb &color : colors) {
+                color = generator.generate();
+            }
+            colors[0] = qRgba(0, 0, 0, 0);
+            image.setColorTable(colors);
+            for (int y = 0; y < size; ++y) {
+                uchar *line = image.scanLine(y);
+                for (int x = 0; x < size; ++x) {
+                    line[x] = generator.bounded(100);
+                }
+            }
+            return image;
+        }
+
+        QImage image(size, size, QImage::Format_ARGB32);
+        for (int y = 0; y < size; ++y) {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < size; ++x) {
+                line[x] = generator.generate();
+            }
+        }
+        return image.convertToFormat(format);
+    }
+
+    // Every effect is measured for all icon sizes and formats, with each kernel set the CPU supports
+    static void addRows()
+    {
+        QTest::addColumn<int>("size");
+        QTest::addColumn<QImage::Format>("format");
+        QTest::addColumn<int>("kernelSet");
+        const std::pair<const char *, QImage::Format> formats[] = {
+            {"indexed", QImage::Format_Indexed8},
+            {"argb32", QImage::Format_ARGB32},
+            {"premultiplied", QImage::Format_ARGB32_Premultiplied},
+        };
+        const QList<QByteArray> kernelSets = kiconeffect_kernel_sets();
+        for (int size : {16, 22, 32, 48, 64, 128, 256, 512}) {
+            for (const auto &[name, format] : formats) {
+                for (int set = 0; set < kernelSets.size(); ++set) {
+                    QTest::addRow("%dpx %s %s", size, name, kernelSets.at(set).constData()) << size << format << set;
+                }
+            }
+        }
+    }
+
+    // The effects work in place, so every call needs a fresh copy of the source.
+    // QBENCHMARK would time making the copies as well, so they are made in
+    // batches ahead of timing the effect on each of them.
+    template<typename Effect>
+    static void measure(const QImage &source, Effect effect)
+    {
+        std::array<QImage, 16> images;
+        QElapsedTimer timer;
+        qint64 elapsed = 0;
+        qint64 calls = 0;
+        while (elapsed < 50 * 1000 * 1000) {
+            for (QImage &image : images) {
+                image = source.copy();
+            }
+            timer.start();
+            for (QImage &image : images) {
+                effect(image);
+            }
+            elapsed += timer.nsecsElapsed();
+            calls += qint64(images.size());
+        }
+        QTest::setBenchmarkResult(qreal(elapsed) / calls, QTest::WalltimeNanoseconds);
+    }
+
+    template<typename Effect>
+    static void run(Effect effect)
+    {
+        QFETCH(int, size);
+        QFETCH(QImage::Format, format);
+        QFETCH(int, kernelSet);
+        kiconeffect_kernel_set = kernelSet;
+        measure(randomImage(size, format), effect);
+        kiconeffect_kernel_set = -1;
+    }
+
+    // The gamma correction as done before it used a lookup table
+    static void toGammaPow(QImage &image, float value)
+    {
+        float gamma = 1 / (2 * value + 0.5);
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                line[x] = qRgba(static_cast<unsigned char>(pow(static_cast<float>(qRed(line[x])) / 255, gamma) * 255),
+                                static_cast<unsigned char>(pow(static_cast<float>(qGreen(line[x])) / 255, gamma) * 255),
+                                static_cast<unsigned char>(pow(static_cast<float>(qBlue(line[x])) / 255, gamma) * 255),
+                                qAlpha(line[x]));
+            }
+        }
+    }
+
+    // The desaturation as done before it worked on the RGB values directly
+    static void deSaturateQColor(QImage &image, float value)
+    {
+        QColor color;
+        int h;
+        int s;
+        int v;
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                color.setRgb(line[x]);
+                color.getHsv(&h, &s, &v);
+                color.setHsv(h, (int)(s * (1.0 - value) + 0.5), v);
+                line[x] = qRgba(color.red(), color.green(), color.blue(), qAlpha(line[x]));
+            }
+        }
+    }
+
+    static void addReferenceRows(const char *reference)
+    {
+        QTest::addColumn<int>("size");
+        QTest::addColumn<bool>("reference");
+        for (int size : {48, 256}) {
+            QTest::addRow("%dpx %s", size, reference) << size << true;
+            QTest::addRow("%dpx now", size) << size << false;
+        }
+    }
+
+    // Compares an effect with the implementation it replaced
+    template<typename Reference, typename Effect>
+    static void compare(Reference referenceEffect, Effect effect, QImage::Format format = QImage::Format_ARGB32)
+    {
+        QFETCH(int, size);
+        QFETCH(bool, reference);
+        if (reference) {
+            measure(randomImage(size, format), referenceEffect);
+        } else {
+            measure(randomImage(size, format), effect);
+        }
+    }
+
+    // Large images are split over the threads of the global thread pool
+    static void addThreadRows()
+    {
+        QTest::addColumn<int>("size");
+        QTest::addColumn<int>("threads");
+        for (int size : {128, 256, 512}) {
+            for (int threads : {1, 2, 4, 8}) {
+                QTest::addRow("%dpx %d threads", size, threads) << size << threads;
+            }
+        }
+    }
+
+    template<typename Effect>
+    static void runThreads(Effect effect)
+    {
+        QFETCH(int, size);
+        QFETCH(int, threads);
+        const int maxThreadCount = QThreadPool::globalInstance()->maxThreadCount();
+        QThreadPool::globalInstance()->setMaxThreadCount(threads);
+        measure(randomImage(size, QImage::Format_ARGB32_Premultiplied), effect);
+        QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
+    }
+
+private Q_SLOTS:
+    void benchmarkToGray_data()
+    {
+        addRows();
+    }
+    void benchmarkToGray()
+    {
+        run([](QImage &image) {
+            KIconEffect::toGray(image, 1.0);
+        });
+    }
+
+    void benchmarkColorize_data()
+    {
+        addRows();
+    }
+    void benchmarkColorize()
+    {
+        run([](QImage &image) {
+            KIconEffect::colorize(image, QColor(30, 140, 250), 0.8);
+        });
+    }
+
+    void benchmarkToMonochrome_data()
+    {
+        addRows();
+    }
+    void benchmarkToMonochrome()
+    {
+        run([](QImage &image) {
+            KIconEffect::toMonochrome(image, Qt::black, Qt::white, 1.0);
+        });
+    }
+
+    void benchmarkDeSaturate_data()
+    {
+        addRows();
+    }
+    void benchmarkDeSaturate()
+    {
+        run([](QImage &image) {
+            KIconEffect::deSaturate(image, 0.6);
+        });
+    }
+
+    void benchmarkToGamma_data()
+    {
+        addRows();
+    }
+    void benchmarkToGamma()
+    {
+        run([](QImage &image) {
+            KIconEffect::toGamma(image, 0.7);
+        });
+    }
+
+    void benchmarkSemiTransparent_data()
+    {
+        addRows();
+    }
+    void benchmarkSemiTransparent()
+    {
+        run([](QImage &image) {
+            KIconEffect::semiTransparent(image);
+        });
+    }
+
+    void benchmarkOverlay_data()
+    {
+        addRows();
+    }
+    void benchmarkOverlay()
+    {
+        QFETCH(int, size);
+        QFETCH(QImage::Format, format);
+        QImage overlay = randomImage(size, format);
+        run([&overlay](QImage &image) {
+            KIconEffect::overlay(image, overlay);
+        });
+    }
+
+#if KICONTHEMES_ENABLE_DEPRECATED_SINCE(6, 5)
+    void benchmarkDoublePixels_data()
+    {
+        addRows();
+    }
+    void benchmarkDoublePixels()
+    {
+        QT_WARNING_PUSH
+        QT_WARNING_DISABLE_DEPRECATED
+        const KIconEffect effect;
+        run([&effect](QImage &image) {
+            image = effect.doublePixels(image);
+        });
+        QT_WARNING_POP
+    }
+#endif
+
+    void benchmarkToDisabled_data()
+    {
+        addRows();
+    }
+    void benchmarkToDisabled()
+    {
+        run([](QImage &image) {
+            KIconEffect::toDisabled(image);
+        });
+    }
+
+    void benchmarkToActive_data()
+    {
+        addRows();
+    }
+    void benchmarkToActive()
+    {
+        run([](QImage &image) {
+            KIconEffect::toActive(image);
+        });
+    }
+
+    // toActive() at the common icon sizes, against the pow() per channel it used before
+    void benchmarkToActiveAgainstPow_data()
+    {
+        addReferenceRows("pow");
+    }
+    void benchmarkToActiveAgainstPow()
+    {
+        compare(
+            [](QImage &image) {
+                toGammaPow(image, 0.7);
+            },
+            [](QImage &image) {
+                KIconEffect::toActive(image);
+            });
+    }
+
+    // Rendered SVGs are premultiplied, before the pipeline they were converted
+    // to ARGB32 for two passes over the pixels and converted back for display
+    void benchmarkToDisabledAgainstSeparatePasses_data()
+    {
+        addReferenceRows("separate");
+    }
+    void benchmarkToDisabledAgainstSeparatePasses()
+    {
+        compare(
+            [](QImage &image) {
+                image.convertTo(QImage::Format_ARGB32);
+                KIconEffect::toGray(image, 1.0);
+                KIconEffect::semiTransparent(image);
+                image.convertTo(QImage::Format_ARGB32_Premultiplied);
+            },
+            [](QImage &image) {
+                KIconEffect::toDisabled(image);
+            },
+            QImage::Format_ARGB32_Premultiplied);
+    }
+
+    void benchmarkDeSaturateAgainstQColor_data()
+    {
+        addReferenceRows("qcolor");
+    }
+    void benchmarkDeSaturateAgainstQColor()
+    {
+        compare(
+            [](QImage &image) {
+                deSaturateQColor(image, 0.6);
+            },
+            [](QImage &image) {
+                KIconEffect::deSaturate(image, 0.6);
+            });
+    }
+
+    void benchmarkToActiveThreads_data()
+    {
+        addThreadRows();
+    }
+    void benchmarkToActiveThreads()
+    {
+        runThreads([](QImage &image) {
+            KIconEffect::toActive(image);
+        });
+    }
+
+    void benchmarkOverlayThreads_data()
+    {
+        addThreadRows();
+    }
+    void benchmarkOverlayThreads()
+    {
+        QFETCH(int, size);
+        QImage overlay = randomImage(size);
+        runThreads([&overlay](QImage &image) {
+            KIconEffect::overlay(image, overlay);
+        });
+    }
+};
+
+QTEST_MAIN(KIconEffect_Benchmark)
+
+#include "kiconeffect_benchmark.moc"
@@ -0,0 +1,556 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KIconThemes authors, see the git history
+
+    The reference implementations of the effects are taken from kiconeffect.cpp:
+    SPDX-FileCopyrightText: 2000 Geert Jansen <jansen@kde.org>
+    SPDX-FileCopyrightText: 2007 Daniel M. Duley <daniel.duley@verizon.net>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#include <kiconeffect.h>
+
+#include <QRandomGenerator>
+#include <QTest>
+#include <QThreadPool>
+
+#include <functional>
+
+#include <math.h>
+
+extern KICONTHEMES_EXPORT int kiconeffect_kernel_set;
+extern KICONTHEMES_EXPORT QList<QByteArray> kiconeffect_kernel_sets();
+
+using Effect = std::function<void(QImage &)>;
+Q_DECLARE_METATYPE(Effect)
+
+static QImage randomImage(int width, int height, QImage::Format format)
+{
+    QRandomGenerator generator(width * 1000 + height);
+    QImage image(width, height, format);
+    if (format == QImage::Format_Indexed8) {
+        QList<QRgb> colors(256);
+        for (QRgb &color : colors) {
+            color = generator.generate();
+        }
+        image.setColorTable(colors);
+        for (int y = 0; y < height; ++y) {
+            uchar *line = image.scanLine(y);
+            for (int x = 0; x < width; ++x) {
+                line[x] = generator.bounded(256);
+            }
+        }
+    } else {
+        for (int y = 0; y < height; ++y) {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < width; ++x) {
+                line[x] = generator.generate();
+            }
+        }
+    }
+    return image;
+}
+
+static QImage grayImage(int width, int height)
+{
+    QImage image = randomImage(width, height, QImage::Format_ARGB32);
+    for (int y = 0; y < height; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            line[x] = qRgba(qRed(line[x]), qRed(line[x]), qRed(line[x]), qAlpha(line[x]));
+        }
+    }
+    return image;
+}
+
+// The largest difference of a channel between two 32 bit images of the same format
+static int maxDifference(const QImage &image1, const QImage &image2)
+{
+    int difference = 0;
+    for (int y = 0; y < image1.height(); ++y) {
+        const QRgb *line1 = reinterpret_cast<const QRgb *>(image1.constScanLine(y));
+        const QRgb *line2 = reinterpret_cast<const QRgb *>(image2.constScanLine(y));
+        for (int x = 0; x < image1.width(); ++x) {
+            difference = qMax(difference, qAbs(qRed(line1[x]) - qRed(line2[x])));
+            difference = qMax(difference, qAbs(qGreen(line1[x]) - qGreen(line2[x])));
+            difference = qMax(difference, qAbs(qBlue(line1[x]) - qBlue(line2[x])));
+            difference = qMax(difference, qAbs(qAlpha(line1[x]) - qAlpha(line2[x])));
+        }
+    }
+    return difference;
+}
+
+// The gamma correction as done before it used a lookup table
+static void toGammaReference(QImage &image, float value)
+{
+    float gamma = 1 / (2 * value + 0.5);
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            line[x] = qRgba(static_cast<unsigned char>(pow(static_cast<float>(qRed(line[x])) / 255, gamma) * 255),
+                            static_cast<unsigned char>(pow(static_cast<float>(qGreen(line[x])) / 255, gamma) * 255),
+                            static_cast<unsigned char>(pow(static_cast<float>(qBlue(line[x])) / 255, gamma) * 255),
+                            qAlpha(line[x]));
+        }
+    }
+}
+
+// The desaturation as done before it worked on the RGB values directly
+static void deSaturateReference(QImage &image, float value)
+{
+    QColor color;
+    int h;
+    int s;
+    int v;
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            color.setRgb(line[x]);
+            color.getHsv(&h, &s, &v);
+            color.setHsv(h, (int)(s * (1.0 - value) + 0.5), v);
+            line[x] = qRgba(color.red(), color.green(), color.blue(), qAlpha(line[x]));
+        }
+    }
+}
+
+// The blending of overlay() as done before it used the kernels
+static void overlayReference(QImage &src, const QImage &overlay)
+{
+    for (int y = 0; y < src.height(); ++y) {
+        const QRgb *oline = reinterpret_cast<const QRgb *>(overlay.constScanLine(y));
+        QRgb *sline = reinterpret_cast<QRgb *>(src.scanLine(y));
+        for (int x = 0; x < src.width(); ++x) {
+            const int a1 = qAlpha(oline[x]);
+            sline[x] = qRgba((a1 * qRed(oline[x]) + (0xff - a1) * qRed(sline[x])) >> 8,
+                             (a1 * qGreen(oline[x]) + (0xff - a1) * qGreen(sline[x])) >> 8,
+                             (a1 * qBlue(oline[x]) + (0xff - a1) * qBlue(sline[x])) >> 8,
+                             qMax(a1, qAlpha(sline[x])));
+        }
+    }
+}
+
+// An overlay with fully transparent and fully opaque pixels among the others, like emblems
+static QImage overlayImage(int width, int height)
+{
+    QRandomGenerator generator(width * height);
+    QImage overlay(width, height, QImage::Format_ARGB32);
+    for (int y = 0; y < height; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(overlay.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            line[x] = generator.generate();
+            if ((x + y) % 3 == 0) {
+                line[x] = x % 2 ? line[x] | 0xff000000 : line[x] & 0x00ffffff;
+            }
+        }
+    }
+    return overlay;
+}
+
+class KIconEffect_UnitTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        m_maxThreadCount = QThreadPool::globalInstance()->maxThreadCount();
+    }
+
+    void cleanup()
+    {
+        kiconeffect_kernel_set = -1;
+        QThreadPool::globalInstance()->setMaxThreadCount(m_maxThreadCount);
+    }
+
+    void testSimdMatchesScalar_data()
+    {
+        QTest::addColumn<QImage>("image");
+        QTest::addColumn<Effect>("effect");
+
+        const QList<Effect> effects = {
+            [](QImage &image) {
+                KIconEffect::toGray(image, 1.0);
+            },
+            [](QImage &image) {
+                KIconEffect::toGray(image, 0.6);
+            },
+            [](QImage &image) {
+                KIconEffect::colorize(image, QColor(30, 140, 250), 0.8);
+            },
+            [](QImage &image) {
+                KIconEffect::toMonochrome(image, QColor(20, 20, 60), QColor(240, 230, 200), 0.9);
+            },
+            [](QImage &image) {
+                KIconEffect::semiTransparent(image);
+            },
+            [](QImage &image) {
+                KIconEffect::toGamma(image, 0.7);
+            },
+            [](QImage &image) {
+                KIconEffect::deSaturate(image, 0.4);
+            },
+        };
+        const QStringList effectNames = {QStringLiteral("gray"),
+                                         QStringLiteral("halfgray"),
+                                         QStringLiteral("colorize"),
+                                         QStringLiteral("monochrome"),
+                                         QStringLiteral("semitransparent"),
+                                         QStringLiteral("gamma"),
+                                         QStringLiteral("desaturate")};
+
+        // Odd sizes leave pixels over for the scalar code after the vector loops
+        const QList<QSize> sizes = {QSize(1, 1), QSize(3, 5), QSize(16, 16), QSize(22, 22), QSize(37, 11), QSize(256, 256)};
+        for (qsizetype i = 0; i < effects.size(); ++i) {
+            for (const QSize &size : sizes) {
+                const QByteArray name = effectNames.at(i).toLatin1() + '_' + QByteArray::number(size.width()) + 'x' + QByteArray::number(size.height());
+                QTest::newRow((name + "_argb32").constData()) << randomImage(size.width(), size.height(), QImage::Format_ARGB32) << effects.at(i);
+                QTest::newRow((name + "_indexed8").constData()) << randomImage(size.width(), size.height(), QImage::Format_Indexed8) << effects.at(i);
+                QTest::newRow((name + "_grayscale").constData()) << grayImage(size.width(), size.height()) << effects.at(i);
+            }
+        }
+    }
+
+    void testSimdMatchesScalar()
+    {
+        QFETCH(QImage, image);
+        QFETCH(Effect, effect);
+
+        kiconeffect_kernel_set = 0;
+        QImage scalar = image.copy();
+        effect(scalar);
+
+        // Every vector kernel set the CPU supports, not only the fastest one
+        const QList<QByteArray> kernelSets = kiconeffect_kernel_sets();
+        for (int set = 1; set < kernelSets.size(); ++set) {
+            kiconeffect_kernel_set = set;
+            QImage simd = image.copy();
+            effect(simd);
+
+            QVERIFY2(simd == scalar, kernelSets.at(set).constData());
+            if (image.format() == QImage::Format_Indexed8) {
+                QVERIFY2(simd.colorTable() == scalar.colorTable(), kernelSets.at(set).constData());
+            }
+        }
+    }
+
+    void testDeSaturate_data()
+    {
+        QTest::addColumn<float>("value");
+
+        QTest::newRow("0.1") << 0.1f;
+        QTest::newRow("0.3") << 0.3f;
+        QTest::newRow("0.5") << 0.5f;
+        QTest::newRow("0.8") << 0.8f;
+        QTest::newRow("1.0") << 1.0f;
+    }
+
+    void testDeSaturate()
+    {
+        QFETCH(float, value);
+
+        const QImage image = randomImage(128, 128, QImage::Format_ARGB32);
+        QImage expected = image.copy();
+        deSaturateReference(expected, value);
+
+        QImage result = image.copy();
+        KIconEffect::deSaturate(result, value);
+
+        // The documented tolerance towards the QColor based code
+        QVERIFY(maxDifference(result, expected) <= 5);
+    }
+
+    void testDeSaturateExtremes()
+    {
+        QImage image = randomImage(32, 32, QImage::Format_ARGB32);
+        const QImage original = image.copy();
+        KIconEffect::deSaturate(image, 0.0);
+        QCOMPARE(image, original);
+
+        // Full desaturation leaves the value of HSV in all channels
+        KIconEffect::deSaturate(image, 1.0);
+        for (int y = 0; y < image.height(); ++y) {
+            for (int x = 0; x < image.width(); ++x) {
+                const QRgb pixel = original.pixel(x, y);
+                const int value = qMax(qMax(qRed(pixel), qGreen(pixel)), qBlue(pixel));
+                QCOMPARE(image.pixel(x, y), qRgba(value, value, value, qAlpha(pixel)));
+            }
+        }
+    }
+
+    void testStateEffects_data()
+    {
+        QTest::addColumn<QImage>("image");
+
+        const QImage image = randomImage(61, 47, QImage::Format_ARGB32);
+        QTest::newRow("argb32") << image;
+        QTest::newRow("premultiplied") << image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        QTest::newRow("rgb32") << image.convertToFormat(QImage::Format_RGB32);
+        QTest::newRow("rgba8888") << image.convertToFormat(QImage::Format_RGBA8888);
+        QTest::newRow("indexed8") << randomImage(7, 7, QImage::Format_Indexed8);
+    }
+
+    // toDisabled() and toActive() run their effects in one pass, check them
+    // against the effects applied one after the other on unpremultiplied pixels
+    void testStateEffects()
+    {
+        QFETCH(QImage, image);
+
+        const auto separately = [&image](const std::function<void(QImage &)> &effects) {
+            QImage result = image.copy();
+            if (result.depth() > 8) {
+                result.convertTo(QImage::Format_ARGB32);
+            }
+            effects(result);
+            if (image.format() == QImage::Format_ARGB32_Premultiplied) {
+                result.convertTo(QImage::Format_ARGB32_Premultiplied);
+            }
+            return result;
+        };
+        // Premultiplied pixels aren't unpremultiplied for toDisabled() anymore, which rounds differently
+        const int tolerance = image.format() == QImage::Format_ARGB32_Premultiplied ? 2 : 0;
+        const QImage::Format expectedFormat = image.format() == QImage::Format_RGBA8888 ? QImage::Format_ARGB32 : image.format();
+
+        QImage disabled = image.copy();
+        KIconEffect::toDisabled(disabled);
+        const QImage expectedDisabled = separately([](QImage &result) {
+            KIconEffect::toGray(result, 1.0);
+            KIconEffect::semiTransparent(result);
+        });
+        QCOMPARE(disabled.format(), expectedFormat);
+        if (image.depth() > 8) {
+            QVERIFY(maxDifference(disabled, expectedDisabled) <= tolerance);
+        } else {
+            QCOMPARE(disabled.colorTable(), expectedDisabled.colorTable());
+        }
+
+        QImage active = image.copy();
+        KIconEffect::toActive(active);
+        const QImage expectedActive = separately([](QImage &result) {
+            KIconEffect::toGamma(result, 0.7);
+        });
+        QCOMPARE(active.format(), expectedFormat);
+        if (image.depth() > 8) {
+            QVERIFY(maxDifference(active, expectedActive) <= tolerance);
+        } else {
+            QCOMPARE(active.colorTable(), expectedActive.colorTable());
+        }
+    }
+
+    void testPremultiplied_data()
+    {
+        QTest::addColumn<Effect>("effect");
+
+        QTest::newRow("gray") << Effect([](QImage &image) {
+            KIconEffect::toGray(image, 1.0);
+        });
+        QTest::newRow("halfgray") << Effect([](QImage &image) {
+            KIconEffect::toGray(image, 0.6);
+        });
+        QTest::newRow("desaturate") << Effect([](QImage &image) {
+            KIconEffect::deSaturate(image, 0.4);
+        });
+        QTest::newRow("semitransparent") << Effect([](QImage &image) {
+            KIconEffect::semiTransparent(image);
+        });
+        QTest::newRow("gamma") << Effect([](QImage &image) {
+            KIconEffect::toGamma(image, 0.7);
+        });
+        QTest::newRow("colorize") << Effect([](QImage &image) {
+            KIconEffect::colorize(image, QColor(30, 140, 250), 0.8);
+        });
+        QTest::newRow("disabled") << Effect([](QImage &image) {
+            KIconEffect::toDisabled(image);
+        });
+    }
+
+    // Premultiplied images used to be converted to ARGB32 for the effects
+    void testPremultiplied()
+    {
+        QFETCH(Effect, effect);
+
+        const QImage image = randomImage(97, 31, QImage::Format_ARGB32).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+        QImage expected = image.convertToFormat(QImage::Format_ARGB32);
+        effect(expected);
+        expected.convertTo(QImage::Format_ARGB32_Premultiplied);
+
+        QImage result = image.copy();
+        effect(result);
+        QCOMPARE(result.format(), QImage::Format_ARGB32_Premultiplied);
+        QVERIFY(maxDifference(result, expected) <= 2);
+
+        for (int y = 0; y < result.height(); ++y) {
+            const QRgb *line = reinterpret_cast<const QRgb *>(result.constScanLine(y));
+            for (int x = 0; x < result.width(); ++x) {
+                QVERIFY(qRed(line[x]) <= qAlpha(line[x]) && qGreen(line[x]) <= qAlpha(line[x]) && qBlue(line[x]) <= qAlpha(line[x]));
+            }
+        }
+    }
+
+    void testPixmapEffects()
+    {
+        const QPixmap source = QPixmap::fromImage(randomImage(32, 32, QImage::Format_ARGB32));
+
+        QPixmap disabled = source;
+        KIconEffect::toDisabled(disabled);
+        QImage expected = source.toImage();
+        KIconEffect::toDisabled(expected);
+        QCOMPARE(disabled.toImage().convertToFormat(QImage::Format_ARGB32), expected.convertToFormat(QImage::Format_ARGB32));
+
+        // Applying the effect again to the same pixmap gives the cached result
+        QPixmap disabledAgain = source;
+        KIconEffect::toDisabled(disabledAgain);
+        QCOMPARE(disabledAgain.cacheKey(), disabled.cacheKey());
+
+        QPixmap active = source;
+        KIconEffect::toActive(active);
+        QVERIFY(active.cacheKey() != disabled.cacheKey());
+        expected = source.toImage();
+        KIconEffect::toActive(expected);
+        QCOMPARE(active.toImage().convertToFormat(QImage::Format_ARGB32), expected.convertToFormat(QImage::Format_ARGB32));
+
+        // A changed pixmap has a new cache key
+        QPixmap changed = source;
+        changed.fill(Qt::red);
+        KIconEffect::toActive(changed);
+        QVERIFY(changed.cacheKey() != active.cacheKey());
+    }
+
+    void testParallel_data()
+    {
+        QTest::addColumn<QImage>("image");
+        QTest::addColumn<Effect>("effect");
+
+        const QImage source = randomImage(512, 509, QImage::Format_ARGB32);
+        const QImage premultiplied = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        const Effect disabled = [](QImage &image) {
+            KIconEffect::toDisabled(image);
+        };
+        const Effect active = [](QImage &image) {
+            KIconEffect::toActive(image);
+        };
+        QTest::newRow("disabled") << source << disabled;
+        QTest::newRow("disabled premultiplied") << premultiplied << disabled;
+        QTest::newRow("active") << source << active;
+        QTest::newRow("active premultiplied") << premultiplied << active;
+        QTest::newRow("monochrome") << source << Effect([](QImage &image) {
+            KIconEffect::toMonochrome(image, QColor(20, 20, 60), QColor(240, 230, 200), 0.9);
+        });
+        QTest::newRow("overlay") << source << Effect([](QImage &image) {
+            QImage overlay = randomImage(image.width(), image.height(), QImage::Format_ARGB32);
+            KIconEffect::overlay(image, overlay);
+        });
+    }
+
+    // Large images are split over several threads
+    void testParallel()
+    {
+        QFETCH(QImage, image);
+        QFETCH(Effect, effect);
+
+        QThreadPool::globalInstance()->setMaxThreadCount(1);
+        QImage serial = image.copy();
+        effect(serial);
+
+        QThreadPool::globalInstance()->setMaxThreadCount(4);
+        QImage parallel = image.copy();
+        effect(parallel);
+
+        QCOMPARE(parallel, serial);
+    }
+
+    void testOverlay_data()
+    {
+        QTest::addColumn<QSize>("size");
+
+        // Odd sizes leave pixels over for the scalar code after the vector loops
+        for (const QSize &size : {QSize(1, 1), QSize(3, 5), QSize(16, 16), QSize(37, 11), QSize(256, 256)}) {
+            QTest::addRow("%dx%d", size.width(), size.height()) << size;
+        }
+    }
+
+    void testOverlay()
+    {
+        QFETCH(QSize, size);
+
+        const QImage image = randomImage(size.width(), size.height(), QImage::Format_ARGB32);
+        QImage overlay = overlayImage(size.width(), size.height());
+
+        QImage expected = image.copy();
+        overlayReference(expected, overlay);
+
+        const QList<QByteArray> kernelSets = kiconeffect_kernel_sets();
+        for (int set = 0; set < kernelSets.size(); ++set) {
+            kiconeffect_kernel_set = set;
+            QImage result = image.copy();
+            KIconEffect::overlay(result, overlay);
+            QVERIFY2(result == expected, kernelSets.at(set).constData());
+        }
+    }
+
+#if KICONTHEMES_ENABLE_DEPRECATED_SINCE(6, 5)
+    void testDoublePixels()
+    {
+        const QImage image = randomImage(37, 11, QImage::Format_ARGB32);
+        QImage expected(image.width() * 2, image.height() * 2, image.format());
+        for (int y = 0; y < expected.height(); ++y) {
+            for (int x = 0; x < expected.width(); ++x) {
+                expected.setPixel(x, y, image.pixel(x / 2, y / 2));
+            }
+        }
+
+        QT_WARNING_PUSH
+        QT_WARNING_DISABLE_DEPRECATED
+        KIconEffect effect;
+        const QList<QByteArray> kernelSets = kiconeffect_kernel_sets();
+        for (int set = 0; set < kernelSets.size(); ++set) {
+            kiconeffect_kernel_set = set;
+            QVERIFY2(effect.doublePixels(image) == expected, kernelSets.at(set).constData());
+        }
+        QT_WARNING_POP
+    }
+#endif
+
+    void testToGamma_data()
+    {
+        QTest::addColumn<float>("value");
+
+        QTest::newRow("active") << 0.7f;
+        QTest::newRow("zero") << 0.0f;
+        QTest::newRow("dark") << 0.2f;
+        QTest::newRow("one") << 1.0f;
+    }
+
+    void testToGamma()
+    {
+        QFETCH(float, value);
+
+        const QImage image = randomImage(67, 33, QImage::Format_ARGB32);
+        QImage expected = image.copy();
+        toGammaReference(expected, value);
+
+        QImage result = image.copy();
+        KIconEffect::toGamma(result, value);
+        QCOMPARE(result, expected);
+
+        // The same through the color table of an indexed image
+        QImage indexed = randomImage(5, 5, QImage::Format_Indexed8);
+        QImage expectedColors(indexed.colorCount(), 1, QImage::Format_ARGB32);
+        for (int i = 0; i < indexed.colorCount(); ++i) {
+            expectedColors.setPixel(i, 0, indexed.color(i));
+        }
+        toGammaReference(expectedColors, value);
+        KIconEffect::toGamma(indexed, value);
+        for (int i = 0; i < indexed.colorCount(); ++i) {
+            QCOMPARE(indexed.color(i), expectedColors.pixel(i, 0));
+        }
+    }
+
+private:
+    int m_maxThreadCount = 0;
+};
+
+QTEST_MAIN(KIconEffect_UnitTest)
+
+#include "kiconeffect_unittest.moc"
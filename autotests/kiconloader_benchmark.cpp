@@ -76,6 +76,25 @@ private Q_SLOTS:
         }
     }
 
+    void benchmarkConstruction()
+    {
+        // the theme tree is only built on the first lookup
+        QBENCHMARK {
+            KIconLoader loader;
+            Q_UNUSED(loader.currentSize(KIconLoader::Desktop));
+        }
+    }
+
+    void benchmarkConstructionAndFirstLookup()
+    {
+        QBENCHMARK {
+            KIconLoader loader;
+            if (loader.iconPath(QStringLiteral("document-open"), KIconLoader::Small, true).isEmpty()) {
+                QSKIP("missing icons");
+            }
+        }
+    }
+
     void benchmarkNonExistingIcon_notCached()
     {
         QBENCHMARK {
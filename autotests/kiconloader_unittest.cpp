@@ -7,10 +7,15 @@
 
 #include <kiconloader.h>
 
+#include <QDateTime>
 #include <QDir>
 #include <QRegularExpression>
+#include <QSignalSpy>
 #include <QStandardPaths>
 #include <QTest>
+#ifdef WITH_QTDBUS
+#include <QDBusConnection>
+#endif
 
 #include <KConfigGroup>
 #include <KIconTheme>
@@ -120,6 +125,14 @@ private Q_SLOTS:
         QVERIFY(QFile::copy(QStringLiteral(":/test-22x22.png"), testIconsDir.filePath(QStringLiteral("fakebreeze/22x22/actions/one.png"))));
 
         QVERIFY(QFile::copy(QStringLiteral(":/test-22x22.png"), testIconsDir.filePath(QStringLiteral("fakebreeze/22x22/actions/one-symbolic.png"))));
+        // unlike one-symbolic.png, a single-colored symbolic icon
+        QImage shape = QImage(QStringLiteral(":/test-22x22.png")).convertToFormat(QImage::Format_ARGB32);
+        for (int y = 0; y < shape.height(); ++y) {
+            for (int x = 0; x < shape.width(); ++x) {
+                shape.setPixel(x, y, qRgba(128, 128, 128, qAlpha(shape.pixel(x, y))));
+            }
+        }
+        QVERIFY(shape.save(testIconsDir.filePath(QStringLiteral("fakebreeze/22x22/actions/shape-symbolic.png"))));
         QVERIFY(QFile::copy(QStringLiteral(":/test-22x22.png"), testIconsDir.filePath(QStringLiteral("fakebreeze/22x22/actions/three.png"))));
 
         QVERIFY(QFile::setPermissions(breezeThemeFile, QFileDevice::ReadOwner | QFileDevice::WriteOwner));
@@ -543,6 +556,348 @@ private Q_SLOTS:
         QVERIFY(path.contains("fakebreeze/22x22/actions"));
         QVERIFY(!path.contains("-symbolic"));
     }
+
+    void testPathIndependentOfState()
+    {
+        // the resolved path is shared by all states, colors and overlays of an icon
+        QString defaultPath;
+        KIconLoader::global()->loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 24, KIconLoader::DefaultState, QStringList(), &defaultPath);
+        QVERIFY(!defaultPath.isEmpty());
+
+        QString activePath;
+        KIconLoader::global()->loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 24, KIconLoader::ActiveState, QStringList(), &activePath);
+        QCOMPARE(activePath, defaultPath);
+
+        QString overlayPath;
+        KIconLoader::global()
+            ->loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 24, KIconLoader::DisabledState, QStringList{QStringLiteral("red")}, &overlayPath);
+        QCOMPARE(overlayPath, defaultPath);
+
+        QCOMPARE(KIconLoader::global()->iconPath(QStringLiteral("kde"), -24), defaultPath);
+    }
+
+    void testStatesDerivedFromBaseImage()
+    {
+        // the states are derived from a shared base image, which must not be modified by the effects
+        KIconLoader iconLoader;
+        const QImage defaultImage = iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22).toImage();
+        QVERIFY(!defaultImage.isNull());
+        const QImage activeImage = iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22, KIconLoader::ActiveState).toImage();
+        const QImage disabledImage = iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22, KIconLoader::DisabledState).toImage();
+        QVERIFY(activeImage != defaultImage);
+        QVERIFY(disabledImage != defaultImage);
+
+        // compare with loaders that render the states in a different order
+        KIconLoader disabledFirstLoader;
+        QCOMPARE(disabledFirstLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22, KIconLoader::DisabledState).toImage(), disabledImage);
+        QCOMPARE(disabledFirstLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22, KIconLoader::ActiveState).toImage(), activeImage);
+        QCOMPARE(disabledFirstLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22).toImage(), defaultImage);
+    }
+
+    void testOverlays()
+    {
+        KIconLoader iconLoader;
+        const QImage plain = iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 48).toImage();
+        const QImage badged = iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 48, KIconLoader::DefaultState, {QStringLiteral("red")}).toImage();
+        QCOMPARE(badged.size(), QSize(48, 48));
+
+        // a 16px emblem is painted in the bottom right corner, with a margin of 5% of the icon size
+        QCOMPARE(badged.pixel(37, 37), qRgb(255, 0, 0));
+        QCOMPARE(badged.pixel(10, 10), plain.pixel(10, 10));
+
+        // an empty overlay keeps its spot, so the emblem ends up in the bottom left corner
+        const QImage badgedLeft =
+            iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 48, KIconLoader::DefaultState, {QString(), QStringLiteral("red")}).toImage();
+        QCOMPARE(badgedLeft.pixel(10, 37), qRgb(255, 0, 0));
+        QCOMPARE(badgedLeft.pixel(37, 37), plain.pixel(37, 37));
+    }
+
+    void testOverlaysOfChangedInheritedTheme()
+    {
+        // the icon comes from the main theme, the emblem from the inherited one
+        const QString emblem = testIconsDir.filePath(QStringLiteral("fakeoxygen/22x22/actions/emblem-kiconloader-test.png"));
+        QImage emblemImage(22, 22, QImage::Format_ARGB32);
+        emblemImage.fill(Qt::red);
+        QVERIFY(emblemImage.save(emblem));
+
+        KIconLoader iconLoader;
+        const QStringList overlays{QStringLiteral("emblem-kiconloader-test")};
+        const QPixmap plain = iconLoader.loadIcon(QStringLiteral("one"), KIconLoader::Desktop, 48);
+        const QImage badged = iconLoader.loadIcon(QStringLiteral("one"), KIconLoader::Desktop, 48, KIconLoader::DefaultState, overlays).toImage();
+        QCOMPARE(badged.pixel(37, 37), qRgb(255, 0, 0));
+
+        // only the inherited theme changes, the icons of the main theme stay cached
+        QVERIFY(QFile::remove(emblem));
+        emblemImage.fill(Qt::blue);
+        QVERIFY(emblemImage.save(emblem));
+        iconLoader.reconfigure(QString());
+        QCOMPARE(iconLoader.loadIcon(QStringLiteral("one"), KIconLoader::Desktop, 48).cacheKey(), plain.cacheKey());
+        const QImage rebadged = iconLoader.loadIcon(QStringLiteral("one"), KIconLoader::Desktop, 48, KIconLoader::DefaultState, overlays).toImage();
+        QCOMPARE(rebadged.pixel(37, 37), qRgb(0, 0, 255));
+
+        QVERIFY(QFile::remove(emblem));
+    }
+
+#if KICONTHEMES_ENABLE_DEPRECATED_SINCE(6, 5)
+    void testDrawOverlaysHiDpi()
+    {
+        KIconLoader iconLoader;
+        const QImage plain = iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 48).toImage();
+        QPixmap pixmap = QPixmap::fromImage(plain);
+        pixmap.setDevicePixelRatio(2);
+        QT_WARNING_PUSH
+        QT_WARNING_DISABLE_DEPRECATED
+        iconLoader.drawOverlays({QStringLiteral("red")}, pixmap, KIconLoader::Desktop);
+        QT_WARNING_POP
+        QCOMPARE(pixmap.devicePixelRatio(), 2.0);
+        const QImage badged = pixmap.toImage();
+        QCOMPARE(badged.size(), QSize(48, 48));
+
+        // the 16px emblem is placed in device pixels, with a margin of 5% of the icon size times the scale
+        QCOMPARE(badged.pixel(28, 28), qRgb(255, 0, 0));
+        QCOMPARE(badged.pixel(43, 43), qRgb(255, 0, 0));
+        QCOMPARE(badged.pixel(27, 27), plain.pixel(27, 27));
+        QCOMPARE(badged.pixel(44, 44), plain.pixel(44, 44));
+    }
+#endif
+
+    void testPaletteChangeKeepsColorIndependentIcons()
+    {
+        KIconLoader iconLoader;
+        QPalette pal;
+        pal.setColor(QPalette::WindowText, QColor(255, 0, 0));
+        iconLoader.setCustomPalette(pal);
+        const QPixmap png = iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22);
+        const QPixmap svg = iconLoader.loadIcon(QStringLiteral("coloredsvgicon"), KIconLoader::NoGroup);
+        QVERIFY(!png.isNull());
+        QVERIFY(!svg.isNull());
+
+        pal.setColor(QPalette::WindowText, QColor(0, 0, 255));
+        iconLoader.setCustomPalette(pal);
+
+        // the png can't follow the palette, so it is still cached
+        QCOMPARE(iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22).cacheKey(), png.cacheKey());
+
+        // the svg has a "current-color-scheme" stylesheet and gets rendered anew
+        const QImage recolored = iconLoader.loadIcon(QStringLiteral("coloredsvgicon"), KIconLoader::NoGroup).toImage();
+        QCOMPARE(recolored.pixel(0, 0), qRgb(0, 0, 255));
+        QCOMPARE(svg.toImage().pixel(0, 0), qRgb(255, 0, 0));
+    }
+
+    void testRasterSymbolicIcon()
+    {
+        KIconLoader iconLoader;
+        QPalette pal;
+        pal.setColor(QPalette::WindowText, QColor(255, 0, 0));
+        iconLoader.setCustomPalette(pal);
+        const QImage source(testIconsDir.filePath(QStringLiteral("fakebreeze/22x22/actions/shape-symbolic.png")));
+        const QImage tinted = iconLoader.loadIcon(QStringLiteral("shape-symbolic"), KIconLoader::Desktop, 22).toImage();
+        QCOMPARE(tinted.size(), source.size());
+
+        // the png only keeps its shape, in the text color of the palette
+        for (int y = 0; y < source.height(); ++y) {
+            for (int x = 0; x < source.width(); ++x) {
+                QCOMPARE(qAlpha(tinted.pixel(x, y)), qAlpha(source.pixel(x, y)));
+                if (qAlpha(source.pixel(x, y)) == 255) {
+                    QCOMPARE(tinted.pixel(x, y), qRgb(255, 0, 0));
+                }
+            }
+        }
+
+        // like the svgs it follows palette changes
+        pal.setColor(QPalette::WindowText, QColor(0, 0, 255));
+        iconLoader.setCustomPalette(pal);
+        const QImage recolored = iconLoader.loadIcon(QStringLiteral("shape-symbolic"), KIconLoader::Desktop, 22).toImage();
+        QCOMPARE(recolored.convertToFormat(QImage::Format_Alpha8), tinted.convertToFormat(QImage::Format_Alpha8));
+        QVERIFY(recolored != tinted);
+
+        // the name alone doesn't make an icon single-colored, a colorful one keeps its colors
+        const QImage colorfulSource(QStringLiteral(":/test-22x22.png"));
+        const QImage colorful = iconLoader.loadIcon(QStringLiteral("one-symbolic"), KIconLoader::Desktop, 22).toImage();
+        QCOMPARE(colorful.size(), colorfulSource.size());
+        for (int y = 0; y < colorfulSource.height(); ++y) {
+            for (int x = 0; x < colorfulSource.width(); ++x) {
+                if (qAlpha(colorfulSource.pixel(x, y)) == 255) {
+                    QCOMPARE(colorful.pixel(x, y), colorfulSource.pixel(x, y));
+                }
+            }
+        }
+    }
+
+    void testReconfigureKeepsUnchangedThemes()
+    {
+        KIconLoader iconLoader;
+        const QPixmap pix = iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22);
+        QVERIFY(!pix.isNull());
+
+        // nothing changed, the icon stays cached
+        iconLoader.reconfigure(QString());
+        QCOMPARE(iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22).cacheKey(), pix.cacheKey());
+
+        // only the application specific hicolor theme at the end of the tree changes
+        iconLoader.reconfigure(QStringLiteral("kiconloader_unittest"));
+        QCOMPARE(iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22).cacheKey(), pix.cacheKey());
+    }
+
+    void testReconfigureFindsNewIcons()
+    {
+        KIconLoader iconLoader;
+        QString path;
+        iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22, KIconLoader::DefaultState, QStringList(), &path);
+        QVERIFY(path.contains(QLatin1String("/fakeoxygen/")));
+
+        // the index file of the main theme is unchanged, but it got a new icon
+        const QString newIcon = testIconsDir.filePath(QStringLiteral("fakebreeze/22x22/apps/kde.png"));
+        QVERIFY(QFile::copy(QStringLiteral(":/test-22x22.png"), newIcon));
+        iconLoader.reconfigure(QString());
+        iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22, KIconLoader::DefaultState, QStringList(), &path);
+        QCOMPARE(path, newIcon);
+
+        QVERIFY(QFile::remove(newIcon));
+        iconLoader.reconfigure(QString());
+        iconLoader.loadIcon(QStringLiteral("kde"), KIconLoader::Desktop, 22, KIconLoader::DefaultState, QStringList(), &path);
+        QVERIFY(path.contains(QLatin1String("/fakeoxygen/")));
+    }
+
+    void testThemesSharedBetweenLoaders()
+    {
+        KIconLoader loader1;
+        KIconLoader loader2(QStringLiteral("otherapp"));
+        QVERIFY(loader1.theme());
+        QCOMPARE(loader2.theme(), loader1.theme());
+
+        // the registry checks the files again, an unchanged theme stays shared
+        KIconTheme::reconfigure();
+        KIconLoader loader3;
+        QCOMPARE(loader3.theme(), loader1.theme());
+
+        // a changed theme is created anew, while existing loaders keep their theme
+        QFile indexFile(testIconsDir.filePath(QStringLiteral("fakebreeze/index.theme")));
+        QVERIFY(indexFile.open(QIODevice::ReadWrite));
+        QVERIFY(indexFile.setFileTime(QDateTime::currentDateTime().addSecs(60), QFileDevice::FileModificationTime));
+        indexFile.close();
+        KIconTheme::reconfigure();
+        KIconLoader loader4;
+        QVERIFY(loader4.theme());
+        QVERIFY(loader4.theme() != loader1.theme());
+        QCOMPARE(loader4.theme()->internalName(), loader1.theme()->internalName());
+    }
+
+    void testQueryIconsCatalog()
+    {
+        KIconLoader iconLoader;
+        const QStringList icons = iconLoader.queryIcons(-22, KIconLoader::MimeType);
+        // text-plain is in both themes, the one of the main theme wins
+        const QStringList textPlain = icons.filter(QStringLiteral("/text-plain.png"));
+        QCOMPARE(textPlain.size(), 1);
+        QVERIFY(textPlain.constFirst().contains(QLatin1String("/fakebreeze/")));
+
+        // the catalog is kept until the theme tree changes
+        const QString newIcon = testIconsDir.filePath(QStringLiteral("fakebreeze/22x22/mimetypes/text-x-new.png"));
+        QVERIFY(QFile::copy(QStringLiteral(":/test-22x22.png"), newIcon));
+        QCOMPARE(iconLoader.queryIcons(-22, KIconLoader::MimeType), icons);
+        iconLoader.reconfigure(QString());
+        QVERIFY(iconLoader.queryIcons(-22, KIconLoader::MimeType).contains(newIcon));
+        QVERIFY(QFile::remove(newIcon));
+    }
+
+    void testForEachIcon()
+    {
+        KIconLoader iconLoader;
+        QStringList paths;
+        KIconLoader::IconEntry textPlain{};
+        iconLoader.forEachIcon(-22, KIconLoader::MimeType, [&paths, &textPlain](const KIconLoader::IconEntry &entry) {
+            if (entry.name == QLatin1String("text-plain")) {
+                textPlain = entry;
+            }
+            paths.append(entry.path);
+            return true;
+        });
+        QCOMPARE(textPlain.size, 22);
+        QCOMPARE(textPlain.context, KIconLoader::MimeType);
+        QVERIFY(textPlain.path.endsWith(QLatin1String("/fakebreeze/22x22/mimetypes/text-plain.png")));
+        QStringList expected = iconLoader.queryIcons(-22, KIconLoader::MimeType);
+        paths.sort();
+        expected.sort();
+        QCOMPARE(paths, expected);
+
+        // the enumeration stops when asked to
+        int count = 0;
+        iconLoader.forEachIcon([&count](const KIconLoader::IconEntry &) {
+            ++count;
+            return count < 2;
+        });
+        QCOMPARE(count, 2);
+    }
+
+    void testIconChangesCoalesced()
+    {
+#ifdef WITH_QTDBUS
+        if (!QDBusConnection::sessionBus().isConnected()) {
+            QSKIP("The changes are broadcast over the session bus");
+        }
+        KIconLoader iconLoader;
+        QSignalSpy spy(&iconLoader, &KIconLoader::iconChanged);
+
+        // a burst that is read from the bus over several turns of the event loop
+        KIconLoader::emitChange(KIconLoader::Desktop);
+        QTest::qWait(10);
+        KIconLoader::emitChange(KIconLoader::Toolbar);
+        QTest::qWait(10);
+        KIconLoader::emitChange(KIconLoader::Desktop);
+        QVERIFY(spy.wait());
+        QTest::qWait(300);
+
+        // one refresh, with each group listed once
+        QCOMPARE(spy.count(), 2);
+        QCOMPARE(spy.at(0).at(0).toInt(), int(KIconLoader::Desktop));
+        QCOMPARE(spy.at(1).at(0).toInt(), int(KIconLoader::Toolbar));
+#else
+        QSKIP("Built without D-Bus");
+#endif
+    }
+
+    void testThemeSwitch()
+    {
+#ifdef WITH_QTDBUS
+        if (!QDBusConnection::sessionBus().isConnected()) {
+            QSKIP("The changes are broadcast over the session bus");
+        }
+        KIconLoader iconLoader;
+        QString path;
+        const QPixmap oldPixmap = iconLoader.loadIcon(QStringLiteral("text-plain"), KIconLoader::Desktop, 22, KIconLoader::DefaultState, {}, &path);
+        QVERIFY(path.contains(QLatin1String("/fakebreeze/")));
+        iconLoader.loadIcon(QStringLiteral("image-x-generic"), KIconLoader::Desktop, 22);
+
+        // the recently used icons were rendered with the new theme ahead of the switch,
+        // so they are served from the cache straight away when the change is announced
+        QList<QPixmap> newPixmaps;
+        connect(&iconLoader, &KIconLoader::iconChanged, this, [&]() {
+            newPixmaps.append(iconLoader.loadIcon(QStringLiteral("text-plain"), KIconLoader::Desktop, 22, KIconLoader::DefaultState, {}, &path));
+            newPixmaps.append(iconLoader.loadIcon(QStringLiteral("text-plain"), KIconLoader::Desktop, 22));
+        });
+
+        QSignalSpy spy(&iconLoader, &KIconLoader::iconChanged);
+        KIconTheme::forceThemeForTests(QStringLiteral("fakeoxygen"));
+        KIconLoader::emitChange(KIconLoader::Desktop);
+        QVERIFY(spy.wait());
+        QTest::qWait(300);
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(spy.at(0).at(0).toInt(), int(KIconLoader::Desktop));
+
+        QCOMPARE(newPixmaps.size(), 2);
+        QVERIFY(path.contains(QLatin1String("/fakeoxygen/")));
+        QVERIFY(newPixmaps.at(0).cacheKey() != oldPixmap.cacheKey());
+        QCOMPARE(newPixmaps.at(1).cacheKey(), newPixmaps.at(0).cacheKey());
+        QCOMPARE(iconLoader.loadIcon(QStringLiteral("text-plain"), KIconLoader::Desktop, 22).cacheKey(), newPixmaps.at(0).cacheKey());
+        QCOMPARE(iconLoader.theme()->internalName(), QStringLiteral("fakeoxygen"));
+
+        KIconTheme::forceThemeForTests(QStringLiteral("fakebreeze"));
+        KIconLoader::global()->reconfigure(QString());
+#else
+        QSKIP("Built without D-Bus");
+#endif
+    }
 };
 
 QTEST_MAIN(KIconLoader_UnitTest)
@@ -4,6 +4,9 @@
     SPDX-License-Identifier: LGPL-2.0-or-later
 */
 
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
 #include <QStandardPaths>
 #include <QTest>
 
@@ -39,6 +42,59 @@ private Q_SLOTS:
         KIconTheme::forceThemeForTests(forcedName);
         QCOMPARE(KIconTheme::current(), forcedName);
     }
+
+    void testListSkipsThemesWithoutDirectories()
+    {
+        const QString iconsDir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/icons");
+        auto writeTheme = [&iconsDir](const QString &name, int secsFromNow) {
+            QVERIFY(QDir().mkpath(iconsDir + QLatin1Char('/') + name));
+            QFile index(iconsDir + QLatin1Char('/') + name + QLatin1String("/index.theme"));
+            QVERIFY(index.open(QIODevice::WriteOnly));
+            index.write("[Icon Theme]\nName=Listed\nDirectories=22x22/apps\n\n[22x22/apps]\nSize=22\nContext=Applications\n");
+            // Make sure that the index counts as changed since the last listing
+            QVERIFY(index.setFileTime(QDateTime::currentDateTime().addSecs(secsFromNow), QFileDevice::FileModificationTime));
+        };
+        writeTheme(QStringLiteral("listed-with-dirs"), 10);
+        QVERIFY(QDir().mkpath(iconsDir + QLatin1String("/listed-with-dirs/22x22/apps")));
+        writeTheme(QStringLiteral("listed-without-dirs"), 10);
+
+        KIconTheme::reconfigure();
+        QVERIFY(KIconTheme::list().contains(QLatin1String("listed-with-dirs")));
+        QVERIFY(!KIconTheme::list().contains(QLatin1String("listed-without-dirs")));
+
+        // The cached result is dropped once the theme changes
+        QVERIFY(QDir().mkpath(iconsDir + QLatin1String("/listed-without-dirs/22x22/apps")));
+        writeTheme(QStringLiteral("listed-without-dirs"), 20);
+        KIconTheme::reconfigure();
+        QVERIFY(KIconTheme::list().contains(QLatin1String("listed-without-dirs")));
+
+        QDir(iconsDir + QLatin1String("/listed-with-dirs")).removeRecursively();
+        QDir(iconsDir + QLatin1String("/listed-without-dirs")).removeRecursively();
+        KIconTheme::reconfigure();
+    }
+
+    void testListNoticesNestedDirectories()
+    {
+        const QString iconsDir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/icons");
+        const QString themeDir = iconsDir + QLatin1String("/listed-nested-dirs");
+        QVERIFY(QDir().mkpath(themeDir + QLatin1String("/22x22")));
+        QFile index(themeDir + QLatin1String("/index.theme"));
+        QVERIFY(index.open(QIODevice::WriteOnly));
+        index.write("[Icon Theme]\nName=Listed\nDirectories=22x22/apps\n\n[22x22/apps]\nSize=22\nContext=Applications\n");
+        index.close();
+
+        KIconTheme::reconfigure();
+        QVERIFY(!KIconTheme::list().contains(QLatin1String("listed-nested-dirs")));
+
+        // Only the modification time of 22x22 changes, give it one that differs
+        QTest::qWait(1000);
+        QVERIFY(QDir().mkpath(themeDir + QLatin1String("/22x22/apps")));
+        KIconTheme::reconfigure();
+        QVERIFY(KIconTheme::list().contains(QLatin1String("listed-nested-dirs")));
+
+        QDir(themeDir).removeRecursively();
+        KIconTheme::reconfigure();
+    }
 };
 
 QTEST_MAIN(KIconTheme_UnitTest)
@@ -0,0 +1,160 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KIconThemes authors, see the git history
+
+    removeIconExtension() is taken from kiconloader.cpp:
+    SPDX-FileCopyrightText: 2000 Geert Jansen <jansen@kde.org>
+    SPDX-FileCopyrightText: 2000 Antonio Larrosa <larrosa@kde.org>
+    SPDX-FileCopyrightText: 2010 Michael Pyne <mpyne@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#ifndef KICONCATALOG_P_H
+#define KICONCATALOG_P_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+#include <algorithm>
+
+/*
+ * Checks if name ends in one of the supported icon formats (i.e. .png)
+ * and returns the name without the extension if it does.
+ */
+inline QStringView removeIconExtension(QStringView name)
+{
+    if (name.endsWith(QLatin1String(".png")) //
+        || name.endsWith(QLatin1String(".xpm")) //
+        || name.endsWith(QLatin1String(".svg"))) {
+        return name.chopped(4);
+    } else if (name.endsWith(QLatin1String(".svgz"))) {
+        return name.chopped(5);
+    }
+
+    return name;
+}
+
+/*
+ * A list of icon files. Instead of one string per absolute path, every
+ * directory is stored once and all file names share one string pool, which
+ * matters for catalogs of whole themes with tens of thousands of icons.
+ *
+ * Header only, it is used by KIconDialog in KIconWidgets.
+ */
+class KIconCatalog
+{
+public:
+    void reserve(qsizetype size)
+    {
+        m_entries.reserve(size);
+        // Assume short file names, the pool grows as needed anyway
+        m_pool.reserve(size * 16);
+    }
+
+    void append(QStringView path)
+    {
+        const qsizetype slash = path.lastIndexOf(QLatin1Char('/'));
+        append(path.left(slash + 1), path.mid(slash + 1));
+    }
+
+    // dir is the directory including the trailing slash
+    void append(QStringView dir, QStringView fileName)
+    {
+        if (m_lastDir < 0 || m_dirs.at(m_lastDir) != dir) {
+            const QString dirString = dir.toString();
+            auto it = m_dirIndex.constFind(dirString);
+            if (it == m_dirIndex.constEnd()) {
+                it = m_dirIndex.insert(dirString, m_dirs.size());
+                m_dirs.append(dirString);
+            }
+            m_lastDir = it.value();
+        }
+        m_entries.append({m_lastDir, int(m_pool.size()), int(fileName.size())});
+        m_pool.append(fileName);
+    }
+
+    qsizetype size() const
+    {
+        return m_entries.size();
+    }
+
+    bool isEmpty() const
+    {
+        return m_entries.isEmpty();
+    }
+
+    void clear()
+    {
+        m_dirs.clear();
+        m_dirIndex.clear();
+        m_pool.clear();
+        m_entries.clear();
+        m_lastDir = -1;
+    }
+
+    QStringView dir(qsizetype i) const
+    {
+        return m_dirs.at(m_entries.at(i).dir);
+    }
+
+    QStringView fileName(qsizetype i) const
+    {
+        const Entry &entry = m_entries.at(i);
+        return QStringView(m_pool).mid(entry.offset, entry.length);
+    }
+
+    // The file name without the icon extension
+    QStringView name(qsizetype i) const
+    {
+        return removeIconExtension(fileName(i));
+    }
+
+    QString path(qsizetype i) const
+    {
+        const QStringView dirName = dir(i);
+        const QStringView file = fileName(i);
+        QString path;
+        path.reserve(dirName.size() + file.size());
+        path.append(dirName);
+        path.append(file);
+        return path;
+    }
+
+    QStringList toStringList() const
+    {
+        QStringList paths;
+        paths.reserve(m_entries.size());
+        for (qsizetype i = 0; i < m_entries.size(); ++i) {
+            paths.append(path(i));
+        }
+        return paths;
+    }
+
+    void sortByFileName()
+    {
+        std::stable_sort(m_entries.begin(), m_entries.end(), [this](const Entry &entry1, const Entry &entry2) {
+            const QStringView fileName1 = QStringView(m_pool).mid(entry1.offset, entry1.length);
+            const QStringView fileName2 = QStringView(m_pool).mid(entry2.offset, entry2.length);
+            return fileName1.compare(fileName2, Qt::CaseInsensitive) < 0;
+        });
+    }
+
+private:
+    struct Entry {
+        int dir;
+        int offset;
+        int length;
+    };
+
+    QStringList m_dirs;
+    QHash<QString, int> m_dirIndex;
+    QString m_pool;
+    QList<Entry> m_entries;
+    int m_lastDir = -1;
+};
+
+#endif // KICONCATALOG_P_H
@@ -12,18 +12,171 @@
 
 #include "kiconeffect.h"
 #include "debug.h"
+#include "kiconeffect_simd_p.h"
 #include "kiconloader.h"
 
 #include <KColorScheme>
 
+#include <QByteArray>
 #include <QDebug>
+#include <QList>
 #include <QPalette>
-#include <QSysInfo>
+#include <QPixmapCache>
+#include <QSemaphore>
+#include <QStringBuilder>
+#include <QThread>
+#include <QThreadPool>
+
+#include <private/qsimd_p.h>
 
 #include <qplatformdefs.h>
 
+#include <algorithm>
+#include <array>
+
 #include <math.h>
 
+static constexpr KIconEffectKernels s_scalarKernels{toGrayScalar,
+                                                    colorizeScalar,
+                                                    toMonochromeScalar,
+                                                    semiTransparentScalar,
+                                                    semiTransparentPremultipliedScalar,
+                                                    tintScalar,
+                                                    tintPremultipliedScalar,
+                                                    toGammaScalar,
+                                                    deSaturateScalar,
+                                                    overlayScalar,
+                                                    doublePixelsScalar};
+#if defined(__SSE2__)
+static constexpr KIconEffectKernels s_simdKernels = vectorKernels<Sse2>();
+#elif defined(__ARM_NEON)
+static constexpr KIconEffectKernels s_simdKernels = vectorKernels<Neon>();
+#endif
+
+namespace
+{
+struct KernelSet {
+    const char *name;
+    const KIconEffectKernels *kernels;
+};
+}
+
+// The kernel sets this CPU supports, from the slowest to the fastest one
+static const QList<KernelSet> &supportedKernelSets()
+{
+    static const QList<KernelSet> sets = [] {
+        QList<KernelSet> supported{{"scalar", &s_scalarKernels}};
+#if defined(__SSE2__)
+        supported.append({"sse2", &s_simdKernels});
+#elif defined(__ARM_NEON)
+        supported.append({"neon", &s_simdKernels});
+#endif
+#ifdef KICONTHEMES_HAVE_AVX2
+        if (qCpuHasFeature(AVX2)) {
+            supported.append({"avx2", &kiconEffectAvx2Kernels});
+        }
+#endif
+        return supported;
+    }();
+    return sets;
+}
+
+// Allows the autotests to run the effects with every kernel set the CPU supports:
+// an index into kiconeffect_kernel_sets(), or -1 for the fastest one
+extern KICONTHEMES_EXPORT int kiconeffect_kernel_set;
+KICONTHEMES_EXPORT int kiconeffect_kernel_set = -1;
+
+extern KICONTHEMES_EXPORT QList<QByteArray> kiconeffect_kernel_sets();
+KICONTHEMES_EXPORT QList<QByteArray> kiconeffect_kernel_sets()
+{
+    QList<QByteArray> names;
+    for (const KernelSet &set : supportedKernelSets()) {
+        names.append(set.name);
+    }
+    return names;
+}
+
+const KIconEffectKernels &kiconEffectKernels()
+{
+    const QList<KernelSet> &sets = supportedKernelSets();
+    if (kiconeffect_kernel_set >= 0 && kiconeffect_kernel_set < sets.size()) {
+        return *sets.at(kiconeffect_kernel_set).kernels;
+    }
+    return *sets.constLast().kernels;
+}
+
+// Below this many pixels per thread, starting the threads costs more than they save
+static constexpr qsizetype s_pixelsPerThread = 128 * 128;
+
+// 4 KiB of pixels, every effect of a pipeline runs over them while they are in the L1 cache
+static constexpr qsizetype s_chunkSize = 1024;
+
+/*
+ * Calls function(first, last) for consecutive parts of the items 0..count-1,
+ * on the threads of the global thread pool when there are enough pixels.
+ * The parts must be independent of each other.
+ */
+template<typename Function>
+static void forEachPart(qsizetype count, qsizetype pixelsPerItem, Function function)
+{
+    const qsizetype parts = qMin(count, qBound<qsizetype>(1, count * pixelsPerItem / s_pixelsPerThread, QThreadPool::globalInstance()->maxThreadCount()));
+    if (parts <= 1) {
+        function(0, count);
+        return;
+    }
+
+    QSemaphore done;
+    int started = 0;
+    for (qsizetype part = 1; part < parts; ++part) {
+        const qsizetype first = count * part / parts;
+        const qsizetype last = count * (part + 1) / parts;
+        auto runPart = [&function, &done, first, last]() {
+            function(first, last);
+            done.release();
+        };
+        // Never queue behind other tasks, this may run on a pool thread itself
+        if (QThreadPool::globalInstance()->tryStart(runPart)) {
+            ++started;
+        } else {
+            function(first, last);
+        }
+    }
+    function(0, count / parts);
+    done.acquire(started);
+}
+
+// The pixmap effects, the results are kept in the QPixmapCache by the cacheKey()
+// of the source pixmap. Asking for the same state of an icon again, as
+// KQuickIconProvider does for every request, then needs no download and upload
+// of the pixels.
+enum class PixmapEffect {
+    Disabled,
+    Active,
+    SemiTransparent,
+};
+
+static void applyToPixmap(QPixmap &pixmap, PixmapEffect effect, void (*imageEffect)(QImage &))
+{
+    if (pixmap.isNull()) {
+        return;
+    }
+
+    // The QPixmapCache may only be used from the GUI thread
+    const bool useCache = QThread::isMainThread();
+    const QString key = QLatin1String("kiconeffect_") % QString::number(pixmap.cacheKey()) % QLatin1Char('_') % QString::number(int(effect));
+    if (useCache && QPixmapCache::find(key, &pixmap)) {
+        return;
+    }
+
+    QImage image = pixmap.toImage();
+    imageEffect(image);
+    pixmap = QPixmap::fromImage(std::move(image));
+
+    if (useCache) {
+        QPixmapCache::insert(key, pixmap);
+    }
+}
+
 class KIconEffectPrivate
 {
 public:
@@ -160,26 +313,28 @@ QImage KIconEffect::apply(const QImage &img, int effect, float value, const QCol
     } else if (value < 0.0) {
         value = 0.0;
     }
+    KIconEffectPipeline pipeline;
     switch (effect) {
     case ToGray:
-        toGray(image, value);
+        pipeline.toGray(value);
         break;
     case DeSaturate:
-        deSaturate(image, value);
+        pipeline.deSaturate(value);
         break;
     case Colorize:
-        colorize(image, col, value);
+        pipeline.colorize(col, value);
         break;
     case ToGamma:
-        toGamma(image, value);
+        pipeline.toGamma(value);
         break;
     case ToMonochrome:
         toMonochrome(image, col, col2, value);
         break;
     }
     if (trans == true) {
-        semiTransparent(image);
+        pipeline.semiTransparent();
     }
+    pipeline.apply(image);
     return image;
 }
 #endif
@@ -267,59 +422,75 @@ struct KIEImgEdit {
     KIEImgEdit &operator=(const KIEImgEdit &) = delete;
 };
 
-// Taken from KImageEffect. We don't want to link kdecore to kdeui! As long
-// as this code is not too big, it doesn't seem much of a problem to me.
-
-void KIconEffect::toGray(QImage &img, float value)
+// Images with less than 8 bits per pixel have too few colors for an alpha
+// channel, so they get every second pixel made transparent instead
+static void semiTransparentMono(QImage &img)
 {
-    if (value == 0.0) {
-        return;
+    // Insert transparent pixel into the clut.
+    int transColor = -1;
+
+    // search for a color that is already transparent
+    for (int x = 0; x < img.colorCount(); ++x) {
+        // try to find already transparent pixel
+        if (qAlpha(img.color(x)) < 127) {
+            transColor = x;
+            break;
+        }
     }
 
-    KIEImgEdit ii(img);
-    QRgb *data = ii.data;
-    QRgb *end = data + ii.pixels;
+    // FIXME: image must have transparency
+    if (transColor < 0 || transColor >= img.colorCount()) {
+        return;
+    }
 
-    unsigned char gray;
-    if (value == 1.0) {
-        while (data != end) {
-            gray = qGray(*data);
-            *data = qRgba(gray, gray, gray, qAlpha(*data));
-            ++data;
+    img.setColor(transColor, 0);
+    unsigned char *line;
+    if (img.depth() == 8) {
+        for (int y = 0; y < img.height(); ++y) {
+            line = img.scanLine(y);
+            for (int x = (y % 2); x < img.width(); x += 2) {
+                line[x] = transColor;
+            }
         }
     } else {
-        unsigned char val = (unsigned char)(255.0 * value);
-        while (data != end) {
-            gray = qGray(*data);
-            *data = qRgba((val * gray + (0xFF - val) * qRed(*data)) >> 8,
-                          (val * gray + (0xFF - val) * qGreen(*data)) >> 8,
-                          (val * gray + (0xFF - val) * qBlue(*data)) >> 8,
-                          qAlpha(*data));
-            ++data;
+        const bool setOn = (transColor != 0);
+        if (img.format() == QImage::Format_MonoLSB) {
+            for (int y = 0; y < img.height(); ++y) {
+                line = img.scanLine(y);
+                for (int x = (y % 2); x < img.width(); x += 2) {
+                    if (!setOn) {
+                        *(line + (x >> 3)) &= ~(1 << (x & 7));
+                    } else {
+                        *(line + (x >> 3)) |= (1 << (x & 7));
+                    }
+                }
+            }
+        } else {
+            for (int y = 0; y < img.height(); ++y) {
+                line = img.scanLine(y);
+                for (int x = (y % 2); x < img.width(); x += 2) {
+                    if (!setOn) {
+                        *(line + (x >> 3)) &= ~(1 << (7 - (x & 7)));
+                    } else {
+                        *(line + (x >> 3)) |= (1 << (7 - (x & 7)));
+                    }
+                }
+            }
         }
     }
 }
 
-void KIconEffect::colorize(QImage &img, const QColor &col, float value)
+static std::array<QRgb, 256> colorizeTable(const QColor &col)
 {
-    if (value == 0.0) {
-        return;
-    }
-
-    KIEImgEdit ii(img);
-    QRgb *data = ii.data;
-    QRgb *end = data + ii.pixels;
-
+    // The color only depends on the gray value of the pixel
+    std::array<QRgb, 256> table;
     float rcol = col.red();
     float gcol = col.green();
     float bcol = col.blue();
     unsigned char red;
     unsigned char green;
     unsigned char blue;
-    unsigned char gray;
-    unsigned char val = (unsigned char)(255.0 * value);
-    while (data != end) {
-        gray = qGray(*data);
+    for (int gray = 0; gray < 256; ++gray) {
         if (gray < 128) {
             red = static_cast<unsigned char>(rcol / 128 * gray);
             green = static_cast<unsigned char>(gcol / 128 * gray);
@@ -333,210 +504,249 @@ void KIconEffect::colorize(QImage &img, const QColor &col, float value)
             green = static_cast<unsigned char>(gcol);
             blue = static_cast<unsigned char>(bcol);
         }
-
-        *data = qRgba((val * red + (0xFF - val) * qRed(*data)) >> 8,
-                      (val * green + (0xFF - val) * qGreen(*data)) >> 8,
-                      (val * blue + (0xFF - val) * qBlue(*data)) >> 8,
-                      qAlpha(*data));
-        ++data;
+        table[gray] = qRgb(red, green, blue);
     }
+    return table;
 }
 
-void KIconEffect::toMonochrome(QImage &img, const QColor &black, const QColor &white, float value)
+static std::array<QRgb, 256> gammaTable(float value)
 {
-    if (value == 0.0) {
-        return;
+    std::array<QRgb, 256> table;
+    float gamma = 1 / (2 * value + 0.5);
+    for (int i = 0; i < 256; ++i) {
+        table[i] = static_cast<unsigned char>(pow(static_cast<float>(i) / 255, gamma) * 255);
     }
+    return table;
+}
 
-    KIEImgEdit ii(img);
-    QRgb *data = ii.data;
-    QRgb *end = data + ii.pixels;
+KIconEffectPipeline &KIconEffectPipeline::toGray(float value)
+{
+    if (value != 0.0) {
+        // Above 255 the kernel doesn't blend but turns the pixels plain gray
+        Stage stage{Stage::ToGray};
+        stage.val = value == 1.0 ? 0x100 : (unsigned char)(255.0 * value);
+        m_stages.append(stage);
+    }
+    return *this;
+}
 
-    // Step 1: determine the average brightness
-    double values = 0.0;
-    double sum = 0.0;
-    bool grayscale = true;
-    while (data != end) {
-        sum += qGray(*data) * qAlpha(*data) + 255 * (255 - qAlpha(*data));
-        values += 255;
-        if ((qRed(*data) != qGreen(*data)) || (qGreen(*data) != qBlue(*data))) {
-            grayscale = false;
-        }
-        ++data;
+KIconEffectPipeline &KIconEffectPipeline::colorize(const QColor &color, float value)
+{
+    if (value != 0.0) {
+        Stage stage{Stage::Colorize};
+        stage.val = (unsigned char)(255.0 * value);
+        stage.table = colorizeTable(color);
+        m_stages.append(stage);
     }
-    double medium = sum / values;
+    return *this;
+}
 
-    // Step 2: Modify the image
-    unsigned char val = (unsigned char)(255.0 * value);
-    int rw = white.red();
-    int gw = white.green();
-    int bw = white.blue();
-    int rb = black.red();
-    int gb = black.green();
-    int bb = black.blue();
-    data = ii.data;
-
-    if (grayscale) {
-        while (data != end) {
-            if (qRed(*data) <= medium) {
-                *data = qRgba((val * rb + (0xFF - val) * qRed(*data)) >> 8,
-                              (val * gb + (0xFF - val) * qGreen(*data)) >> 8,
-                              (val * bb + (0xFF - val) * qBlue(*data)) >> 8,
-                              qAlpha(*data));
+KIconEffectPipeline &KIconEffectPipeline::toGamma(float value)
+{
+    // Used by toActive() for every active icon
+    static const std::array<QRgb, 256> activeTable = gammaTable(0.7f);
+
+    Stage stage{Stage::ToGamma};
+    stage.table = value == 0.7f ? activeTable : gammaTable(value);
+    m_stages.append(stage);
+    return *this;
+}
+
+KIconEffectPipeline &KIconEffectPipeline::deSaturate(float value)
+{
+    if (value != 0.0) {
+        // This used to go through QColor::getHsv() and setHsv() for every pixel.
+        // Working on the RGB values directly gives colors that differ by at most
+        // 5 per channel, mostly because QColor rounds the hue to whole degrees.
+        Stage stage{Stage::DeSaturate};
+        stage.val = qBound(0, int((1.0f - value) * 256 + 0.5f), 256);
+        m_stages.append(stage);
+    }
+    return *this;
+}
+
+KIconEffectPipeline &KIconEffectPipeline::semiTransparent()
+{
+    m_stages.append(Stage{Stage::SemiTransparent});
+    return *this;
+}
+
+KIconEffectPipeline &KIconEffectPipeline::tint(const QColor &color)
+{
+    Stage stage{Stage::Tint};
+    stage.color = color.rgb();
+    m_stages.append(stage);
+    return *this;
+}
+
+bool KIconEffectPipeline::worksOnPremultiplied() const
+{
+    return std::all_of(m_stages.cbegin(), m_stages.cend(), [](const Stage &stage) {
+        // The others look up tables by the value of unpremultiplied channels
+        return stage.type == Stage::ToGray || stage.type == Stage::DeSaturate || stage.type == Stage::SemiTransparent
+            || stage.type == Stage::Tint;
+    });
+}
+
+void KIconEffectPipeline::run(QRgb *data, qsizetype count, bool premultiplied) const
+{
+    const KIconEffectKernels &kernels = kiconEffectKernels();
+    for (const Stage &stage : m_stages) {
+        switch (stage.type) {
+        case Stage::ToGray:
+            kernels.toGray(data, count, stage.val);
+            break;
+        case Stage::Colorize:
+            kernels.colorize(data, count, stage.table.data(), stage.val);
+            break;
+        case Stage::ToGamma:
+            kernels.toGamma(data, count, stage.table.data());
+            break;
+        case Stage::DeSaturate:
+            kernels.deSaturate(data, count, stage.val);
+            break;
+        case Stage::SemiTransparent:
+            if (premultiplied) {
+                kernels.semiTransparentPremultiplied(data, count);
             } else {
-                *data = qRgba((val * rw + (0xFF - val) * qRed(*data)) >> 8,
-                              (val * gw + (0xFF - val) * qGreen(*data)) >> 8,
-                              (val * bw + (0xFF - val) * qBlue(*data)) >> 8,
-                              qAlpha(*data));
+                kernels.semiTransparent(data, count);
             }
-            ++data;
-        }
-    } else {
-        while (data != end) {
-            if (qGray(*data) <= medium) {
-                *data = qRgba((val * rb + (0xFF - val) * qRed(*data)) >> 8,
-                              (val * gb + (0xFF - val) * qGreen(*data)) >> 8,
-                              (val * bb + (0xFF - val) * qBlue(*data)) >> 8,
-                              qAlpha(*data));
+            break;
+        case Stage::Tint:
+            if (premultiplied) {
+                kernels.tintPremultiplied(data, count, stage.color);
             } else {
-                *data = qRgba((val * rw + (0xFF - val) * qRed(*data)) >> 8,
-                              (val * gw + (0xFF - val) * qGreen(*data)) >> 8,
-                              (val * bw + (0xFF - val) * qBlue(*data)) >> 8,
-                              qAlpha(*data));
+                kernels.tint(data, count, stage.color);
             }
-            ++data;
+            break;
         }
     }
 }
 
-void KIconEffect::deSaturate(QImage &img, float value)
+void KIconEffectPipeline::apply(QImage &image) const
 {
-    if (value == 0.0) {
+    if (m_stages.isEmpty() || image.isNull()) {
         return;
     }
 
-    KIEImgEdit ii(img);
-    QRgb *data = ii.data;
-    QRgb *end = data + ii.pixels;
+    if (image.depth() < 8) {
+        // These can't be made semi-transparent through their colors
+        KIconEffectPipeline colorEffects = *this;
+        if (colorEffects.m_stages.removeIf([](const Stage &stage) {
+                return stage.type == Stage::SemiTransparent;
+            })) {
+            colorEffects.apply(image);
+            semiTransparentMono(image);
+            return;
+        }
+    }
 
-    QColor color;
-    int h;
-    int s;
-    int v;
-    while (data != end) {
-        color.setRgb(*data);
-        color.getHsv(&h, &s, &v);
-        color.setHsv(h, (int)(s * (1.0 - value) + 0.5), v);
-        *data = qRgba(color.red(), color.green(), color.blue(), qAlpha(*data));
-        ++data;
+    if (image.depth() <= 8) {
+        QList<QRgb> colors = image.colorTable();
+        run(colors.data(), colors.size(), false);
+        image.setColorTable(colors);
+        return;
+    }
+
+    if (image.format() != QImage::Format_ARGB32 && image.format() != QImage::Format_RGB32
+        && image.format() != QImage::Format_ARGB32_Premultiplied) {
+        image.convertTo(QImage::Format_ARGB32);
     }
+
+    // 32 bit images have no padding at the end of the lines
+    QRgb *data = reinterpret_cast<QRgb *>(image.bits());
+    const qsizetype pixels = qsizetype(image.width()) * image.height();
+    const bool premultiplied = image.format() == QImage::Format_ARGB32_Premultiplied;
+    const bool unpremultiply = premultiplied && !worksOnPremultiplied();
+
+    const qsizetype chunks = (pixels + s_chunkSize - 1) / s_chunkSize;
+    forEachPart(chunks, s_chunkSize, [this, data, pixels, premultiplied, unpremultiply](qsizetype first, qsizetype last) {
+        QRgb chunk[s_chunkSize];
+        for (qsizetype i = first * s_chunkSize; i < qMin(last * s_chunkSize, pixels); i += s_chunkSize) {
+            const qsizetype count = qMin(s_chunkSize, pixels - i);
+            if (!unpremultiply) {
+                run(data + i, count, premultiplied);
+                continue;
+            }
+            for (qsizetype j = 0; j < count; ++j) {
+                chunk[j] = qUnpremultiply(data[i + j]);
+            }
+            run(chunk, count, false);
+            for (qsizetype j = 0; j < count; ++j) {
+                data[i + j] = qPremultiply(chunk[j]);
+            }
+        }
+    });
 }
 
-void KIconEffect::toGamma(QImage &img, float value)
+// Taken from KImageEffect. We don't want to link kdecore to kdeui! As long
+// as this code is not too big, it doesn't seem much of a problem to me.
+
+void KIconEffect::toGray(QImage &img, float value)
 {
+    KIconEffectPipeline().toGray(value).apply(img);
+}
+
+void KIconEffect::colorize(QImage &img, const QColor &col, float value)
+{
+    KIconEffectPipeline().colorize(col, value).apply(img);
+}
+
+void KIconEffect::toMonochrome(QImage &img, const QColor &black, const QColor &white, float value)
+{
+    if (value == 0.0) {
+        return;
+    }
+
     KIEImgEdit ii(img);
     QRgb *data = ii.data;
     QRgb *end = data + ii.pixels;
 
-    float gamma = 1 / (2 * value + 0.5);
+    if (data == end) {
+        return;
+    }
+
+    // Step 1: determine the average brightness
+    quint64 sum = 0;
+    bool grayscale = true;
     while (data != end) {
-        *data = qRgba(static_cast<unsigned char>(pow(static_cast<float>(qRed(*data)) / 255, gamma) * 255),
-                      static_cast<unsigned char>(pow(static_cast<float>(qGreen(*data)) / 255, gamma) * 255),
-                      static_cast<unsigned char>(pow(static_cast<float>(qBlue(*data)) / 255, gamma) * 255),
-                      qAlpha(*data));
+        sum += qGray(*data) * qAlpha(*data) + 255 * (255 - qAlpha(*data));
+        if ((qRed(*data) != qGreen(*data)) || (qGreen(*data) != qBlue(*data))) {
+            grayscale = false;
+        }
         ++data;
     }
+    double medium = double(sum) / (255.0 * ii.pixels);
+
+    // Step 2: Modify the image
+    unsigned char val = (unsigned char)(255.0 * value);
+    // The brightness is an integer, so comparing it with the truncated medium is the same
+    const KIconEffectKernels &kernels = kiconEffectKernels();
+    forEachPart(ii.pixels, 1, [&](qsizetype first, qsizetype last) {
+        kernels.toMonochrome(ii.data + first, last - first, grayscale, int(medium), black.rgb(), white.rgb(), val);
+    });
 }
 
-void KIconEffect::semiTransparent(QImage &img)
+void KIconEffect::deSaturate(QImage &img, float value)
 {
-    if (img.depth() == 32) {
-        if (img.format() == QImage::Format_ARGB32_Premultiplied) {
-            img.convertTo(QImage::Format_ARGB32);
-        }
-        int width = img.width();
-        int height = img.height();
-
-        unsigned char *line;
-        for (int y = 0; y < height; ++y) {
-            if (QSysInfo::ByteOrder == QSysInfo::BigEndian) {
-                line = img.scanLine(y);
-            } else {
-                line = img.scanLine(y) + 3;
-            }
-            for (int x = 0; x < width; ++x) {
-                *line >>= 1;
-                line += 4;
-            }
-        }
-    } else if (img.depth() == 8) {
-        // not running on 8 bit, we can safely install a new colorTable
-        QList<QRgb> colorTable = img.colorTable();
-        for (int i = 0; i < colorTable.size(); ++i) {
-            colorTable[i] = (colorTable[i] & 0x00ffffff) | ((colorTable[i] & 0xfe000000) >> 1);
-        }
-        img.setColorTable(colorTable);
-    } else {
-        // Insert transparent pixel into the clut.
-        int transColor = -1;
-
-        // search for a color that is already transparent
-        for (int x = 0; x < img.colorCount(); ++x) {
-            // try to find already transparent pixel
-            if (qAlpha(img.color(x)) < 127) {
-                transColor = x;
-                break;
-            }
-        }
+    KIconEffectPipeline().deSaturate(value).apply(img);
+}
 
-        // FIXME: image must have transparency
-        if (transColor < 0 || transColor >= img.colorCount()) {
-            return;
-        }
+void KIconEffect::toGamma(QImage &img, float value)
+{
+    KIconEffectPipeline().toGamma(value).apply(img);
+}
 
-        img.setColor(transColor, 0);
-        unsigned char *line;
-        if (img.depth() == 8) {
-            for (int y = 0; y < img.height(); ++y) {
-                line = img.scanLine(y);
-                for (int x = (y % 2); x < img.width(); x += 2) {
-                    line[x] = transColor;
-                }
-            }
-        } else {
-            const bool setOn = (transColor != 0);
-            if (img.format() == QImage::Format_MonoLSB) {
-                for (int y = 0; y < img.height(); ++y) {
-                    line = img.scanLine(y);
-                    for (int x = (y % 2); x < img.width(); x += 2) {
-                        if (!setOn) {
-                            *(line + (x >> 3)) &= ~(1 << (x & 7));
-                        } else {
-                            *(line + (x >> 3)) |= (1 << (x & 7));
-                        }
-                    }
-                }
-            } else {
-                for (int y = 0; y < img.height(); ++y) {
-                    line = img.scanLine(y);
-                    for (int x = (y % 2); x < img.width(); x += 2) {
-                        if (!setOn) {
-                            *(line + (x >> 3)) &= ~(1 << (7 - (x & 7)));
-                        } else {
-                            *(line + (x >> 3)) |= (1 << (7 - (x & 7)));
-                        }
-                    }
-                }
-            }
-        }
-    }
+void KIconEffect::semiTransparent(QImage &img)
+{
+    KIconEffectPipeline().semiTransparent().apply(img);
 }
 
 void KIconEffect::semiTransparent(QPixmap &pix)
 {
-    QImage img = pix.toImage();
-    semiTransparent(img);
-    pix = QPixmap::fromImage(img);
+    applyToPixmap(pix, PixmapEffect::SemiTransparent, [](QImage &image) {
+        semiTransparent(image);
+    });
 }
 
 QImage KIconEffect::doublePixels(const QImage &src) const
@@ -554,14 +764,11 @@ QImage KIconEffect::doublePixels(const QImage &src) const
     int x;
     int y;
     if (src.depth() == 32) {
-        QRgb *l1;
-        QRgb *l2;
+        const KIconEffectKernels &kernels = kiconEffectKernels();
         for (y = 0; y < h; ++y) {
-            l1 = (QRgb *)src.scanLine(y);
-            l2 = (QRgb *)dst.scanLine(y * 2);
-            for (x = 0; x < w; ++x) {
-                l2[x * 2] = l2[x * 2 + 1] = l1[x];
-            }
+            const QRgb *l1 = reinterpret_cast<const QRgb *>(src.constScanLine(y));
+            QRgb *l2 = reinterpret_cast<QRgb *>(dst.scanLine(y * 2));
+            kernels.doublePixels(l2, l1, w);
             memcpy(dst.scanLine(y * 2 + 1), l2, dst.bytesPerLine());
         }
     } else {
@@ -661,64 +868,44 @@ void KIconEffect::overlay(QImage &src, QImage &overlay)
     // Overlay at 32 bpp does use alpha blending
 
     if (src.depth() == 32) {
-        QRgb *oline;
-        QRgb *sline;
-        int r1;
-        int g1;
-        int b1;
-        int a1;
-        int r2;
-        int g2;
-        int b2;
-        int a2;
-
-        for (i = 0; i < src.height(); ++i) {
-            oline = (QRgb *)overlay.scanLine(i);
-            sline = (QRgb *)src.scanLine(i);
-
-            for (j = 0; j < src.width(); ++j) {
-                r1 = qRed(oline[j]);
-                g1 = qGreen(oline[j]);
-                b1 = qBlue(oline[j]);
-                a1 = qAlpha(oline[j]);
-
-                r2 = qRed(sline[j]);
-                g2 = qGreen(sline[j]);
-                b2 = qBlue(sline[j]);
-                a2 = qAlpha(sline[j]);
-
-                r2 = (a1 * r1 + (0xff - a1) * r2) >> 8;
-                g2 = (a1 * g1 + (0xff - a1) * g2) >> 8;
-                b2 = (a1 * b1 + (0xff - a1) * b2) >> 8;
-                a2 = qMax(a1, a2);
-
-                sline[j] = qRgba(r2, g2, b2, a2);
+        // scanLine() may not be called from several threads, it counts detaches
+        uchar *srcBits = src.bits();
+        const uchar *overlayBits = overlay.constBits();
+        const qsizetype srcBytesPerLine = src.bytesPerLine();
+        const qsizetype overlayBytesPerLine = overlay.bytesPerLine();
+        const int width = src.width();
+
+        const KIconEffectKernels &kernels = kiconEffectKernels();
+        forEachPart(src.height(), width, [=, &kernels](qsizetype first, qsizetype last) {
+            for (qsizetype i = first; i < last; ++i) {
+                const QRgb *oline = reinterpret_cast<const QRgb *>(overlayBits + i * overlayBytesPerLine);
+                QRgb *sline = reinterpret_cast<QRgb *>(srcBits + i * srcBytesPerLine);
+                kernels.overlay(sline, oline, width);
             }
-        }
+        });
     }
 }
 
 void KIconEffect::toDisabled(QImage &image)
 {
-    KIconEffect::toGray(image, 1);
-    KIconEffect::semiTransparent(image);
+    KIconEffectPipeline().toGray(1).semiTransparent().apply(image);
 }
 
 void KIconEffect::toDisabled(QPixmap &pixmap)
 {
-    QImage img = pixmap.toImage();
-    toDisabled(img);
-    pixmap = QPixmap::fromImage(img);
+    applyToPixmap(pixmap, PixmapEffect::Disabled, [](QImage &image) {
+        toDisabled(image);
+    });
 }
 
 void KIconEffect::toActive(QImage &image)
 {
-    KIconEffect::toGamma(image, 0.7);
+    KIconEffectPipeline().toGamma(0.7).apply(image);
 }
 
 void KIconEffect::toActive(QPixmap &pixmap)
 {
-    QImage img = pixmap.toImage();
-    KIconEffect::toGamma(img, 0.7);
-    pixmap = QPixmap::fromImage(img);
+    applyToPixmap(pixmap, PixmapEffect::Active, [](QImage &image) {
+        toActive(image);
+    });
 }
@@ -302,6 +302,11 @@ public:
     /*!
      * Desaturates an image.
      *
+     * The saturation is reduced while hue and value stay the same. Since
+     * KIconThemes 6.30 this works on the RGB values directly and no longer
+     * through QColor, the colors can differ by up to 5 per channel from
+     * older versions.
+     *
      * \a image The image
      *
      * \a value Strength of the effect. 0 <= \a value <= 1
@@ -327,6 +332,10 @@ public:
     /*!
      * Renders a pixmap semi-transparent.
      *
+     * The result is kept in the QPixmapCache by the QPixmap::cacheKey() of
+     * \a pixmap, applying the effect to the same pixmap again in the GUI
+     * thread is cheap.
+     *
      * \a pixmap The pixmap
      */
     static void semiTransparent(QPixmap &pixmap);
@@ -352,6 +361,10 @@ public:
     /*!
      * Applies a disabled effect
      *
+     * The result is kept in the QPixmapCache by the QPixmap::cacheKey() of
+     * \a pixmap, applying the effect to the same pixmap again in the GUI
+     * thread is cheap.
+     *
      * \a pixmap The image
      *
      * \since 6.5
@@ -370,6 +383,10 @@ public:
     /*!
      * Applies an effect for an icon that is in an 'active' state
      *
+     * The result is kept in the QPixmapCache by the QPixmap::cacheKey() of
+     * \a pixmap, applying the effect to the same pixmap again in the GUI
+     * thread is cheap.
+     *
      * \a pixmap The image
      *
      * \since 6.5
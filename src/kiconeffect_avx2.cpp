@@ -0,0 +1,16 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KIconThemes authors, see the git history
+
+    The kernels implement the effects of kiconeffect.cpp, under its license.
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+// Only the kernels are built for AVX2, kiconEffectKernels() only uses them on CPUs supporting it
+#include <private/qsimd_p.h>
+
+#define KICONEFFECT_KERNEL_TARGET QT_FUNCTION_TARGET(AVX2)
+#include "kiconeffect_simd_p.h"
+
+const KIconEffectKernels kiconEffectAvx2Kernels = vectorKernels<Avx2>();
@@ -0,0 +1,115 @@
+/*
+    This file is part of the KDE project, module kdecore.
+    SPDX-FileCopyrightText: 2000 Geert Jansen <jansen@kde.org>
+    SPDX-FileCopyrightText: 2007 Daniel M. Duley <daniel.duley@verizon.net>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#ifndef KICONEFFECT_P_H
+#define KICONEFFECT_P_H
+
+#include <QImage>
+#include <QRgb>
+#include <QVarLengthArray>
+#include <QtGlobal>
+
+#include <array>
+
+class QColor;
+
+/*
+ * The per-pixel work of the KIconEffect effects. The kernels work on runs of
+ * unpremultiplied ARGB32 pixels, which is also what the color table of an
+ * indexed image holds. There is a scalar set and sets using the SIMD
+ * instructions of the CPU, all of them giving the same results.
+ *
+ * toGray and deSaturate only scale and mix the color channels, so they work
+ * on premultiplied pixels just as well. semiTransparent has a separate
+ * kernel for them, and so does tint.
+ */
+struct KIconEffectKernels {
+    // val is the strength of the effect in 0..255, above 255 the pixels become plain gray
+    void (*toGray)(QRgb *data, qsizetype count, int val);
+    // table maps the gray value of a pixel to its colorized color, val is the strength in 0..255
+    void (*colorize)(QRgb *data, qsizetype count, const QRgb *table, int val);
+    // Pixels brighter than threshold go to white, the others to black. With
+    // grayscale set, the red channel is used as brightness.
+    void (*toMonochrome)(QRgb *data, qsizetype count, bool grayscale, int threshold, QRgb black, QRgb white, int val);
+    void (*semiTransparent)(QRgb *data, qsizetype count);
+    void (*semiTransparentPremultiplied)(QRgb *data, qsizetype count);
+    // Gives all pixels the color of color, keeping their alpha
+    void (*tint)(QRgb *data, qsizetype count, QRgb color);
+    void (*tintPremultiplied)(QRgb *data, qsizetype count, QRgb color);
+    // table maps each value of the color channels to its new value
+    void (*toGamma)(QRgb *data, qsizetype count, const QRgb *table);
+    // val is the saturation that is kept in 0..256
+    void (*deSaturate)(QRgb *data, qsizetype count, int val);
+    // Blends overlay over data by the alpha of overlay, keeping the larger alpha
+    void (*overlay)(QRgb *data, const QRgb *overlay, qsizetype count);
+    // Writes every pixel of data twice into destination
+    void (*doublePixels)(QRgb *destination, const QRgb *data, qsizetype count);
+};
+
+/*
+ * Returns the kernels to use on this CPU.
+ */
+const KIconEffectKernels &kiconEffectKernels();
+
+#ifdef KICONTHEMES_HAVE_AVX2
+// In kiconeffect_avx2.cpp, the kernels in there are built for AVX2
+extern const KIconEffectKernels kiconEffectAvx2Kernels;
+#endif
+
+/*
+ * A sequence of per-pixel effects that is applied in a single pass over the
+ * image: the pixels are processed in chunks that fit into the L1 cache, and
+ * every effect runs on a chunk before moving on to the next one.
+ *
+ * Premultiplied images keep their format. When all effects work on
+ * premultiplied pixels they run on the image directly, otherwise the pixels
+ * are unpremultiplied chunk by chunk. The values of the effects mean the same
+ * as for KIconEffect, effects with a value of 0 are left out.
+ */
+class KIconEffectPipeline
+{
+public:
+    KIconEffectPipeline &toGray(float value);
+    KIconEffectPipeline &colorize(const QColor &color, float value);
+    KIconEffectPipeline &toGamma(float value);
+    KIconEffectPipeline &deSaturate(float value);
+    KIconEffectPipeline &semiTransparent();
+    // Recolors single-colored icons, see tint in KIconEffectKernels
+    KIconEffectPipeline &tint(const QColor &color);
+
+    bool isEmpty() const
+    {
+        return m_stages.isEmpty();
+    }
+
+    // Whether all effects can be applied to premultiplied pixels without unpremultiplying them
+    bool worksOnPremultiplied() const;
+
+    void apply(QImage &image) const;
+
+private:
+    struct Stage {
+        enum Type {
+            ToGray,
+            Colorize,
+            ToGamma,
+            DeSaturate,
+            SemiTransparent,
+            Tint,
+        } type;
+        int val = 0;
+        QRgb color = 0;
+        std::array<QRgb, 256> table = {};
+    };
+
+    void run(QRgb *data, qsizetype count, bool premultiplied) const;
+
+    QVarLengthArray<Stage, 4> m_stages;
+};
+
+#endif // KICONEFFECT_P_H
@@ -0,0 +1,653 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KIconThemes authors, see the git history
+
+    The kernels implement the effects of kiconeffect.cpp, under its license.
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#ifndef KICONEFFECT_SIMD_P_H
+#define KICONEFFECT_SIMD_P_H
+
+#include "kiconeffect_p.h"
+
+#include <private/qsimd_p.h>
+
+#if defined(__SSE2__) || defined(KICONTHEMES_HAVE_AVX2)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Everything in here is compiled once per instruction set, by kiconeffect.cpp
+// and by kiconeffect_avx2.cpp. It is kept out of the way of the linker so that
+// no function built for AVX2 ends up being used on other CPUs.
+//
+// Only the vector kernels are built for AVX2, by defining KICONEFFECT_KERNEL_TARGET
+// before including this header. Both files are compiled for the baseline CPU,
+// so the inline functions of Qt they share with the rest of the library are too.
+#ifndef KICONEFFECT_KERNEL_TARGET
+#define KICONEFFECT_KERNEL_TARGET
+#endif
+
+namespace
+{
+
+// The scalar versions of the kernels, also used for the pixels left over by the vector loops.
+
+inline QRgb blendPixel(QRgb pixel, int red, int green, int blue, int val)
+{
+    return qRgba((val * red + (0xFF - val) * qRed(pixel)) >> 8,
+                 (val * green + (0xFF - val) * qGreen(pixel)) >> 8,
+                 (val * blue + (0xFF - val) * qBlue(pixel)) >> 8,
+                 qAlpha(pixel));
+}
+
+inline QRgb grayPixel(QRgb pixel, int val)
+{
+    const int gray = qGray(pixel);
+    if (val > 0xFF) {
+        return qRgba(gray, gray, gray, qAlpha(pixel));
+    }
+    return blendPixel(pixel, gray, gray, gray, val);
+}
+
+inline QRgb colorizePixel(QRgb pixel, const QRgb *table, int val)
+{
+    const QRgb color = table[qGray(pixel)];
+    return blendPixel(pixel, qRed(color), qGreen(color), qBlue(color), val);
+}
+
+inline QRgb monochromePixel(QRgb pixel, bool grayscale, int threshold, QRgb black, QRgb white, int val)
+{
+    const QRgb color = (grayscale ? qRed(pixel) : qGray(pixel)) <= threshold ? black : white;
+    return blendPixel(pixel, qRed(color), qGreen(color), qBlue(color), val);
+}
+
+inline QRgb semiTransparentPixel(QRgb pixel)
+{
+    return (pixel & 0x00ffffff) | ((pixel >> 1) & 0x7f000000);
+}
+
+// Halving all channels keeps them within the halved alpha
+inline QRgb semiTransparentPremultipliedPixel(QRgb pixel)
+{
+    return (pixel >> 1) & 0x7f7f7f7f;
+}
+
+// Only the alpha channel of a single-colored icon carries its shape
+inline QRgb tintPixel(QRgb pixel, QRgb color)
+{
+    return (color & 0x00ffffff) | (pixel & 0xff000000);
+}
+
+// The same as qPremultiply(tintPixel(pixel, color)), with the alpha taken as it is
+inline QRgb tintPremultipliedPixel(QRgb pixel, QRgb color)
+{
+    const int alpha = qAlpha(pixel);
+    const auto multiply = [alpha](int channel) {
+        const int t = channel * alpha;
+        return (t + (t >> 8) + 0x80) >> 8;
+    };
+    return qRgba(multiply(qRed(color)), multiply(qGreen(color)), multiply(qBlue(color)), alpha);
+}
+
+inline QRgb gammaPixel(QRgb pixel, const QRgb *table)
+{
+    return qRgba(table[qRed(pixel)], table[qGreen(pixel)], table[qBlue(pixel)], qAlpha(pixel));
+}
+
+// Keeping hue and value of HSV, reducing the saturation comes down to moving
+// every channel towards the largest one
+inline QRgb deSaturatePixel(QRgb pixel, int val)
+{
+    const int value = qMax(qMax(qRed(pixel), qGreen(pixel)), qBlue(pixel));
+    return qRgba(value - (((value - qRed(pixel)) * val + 0x80) >> 8),
+                 value - (((value - qGreen(pixel)) * val + 0x80) >> 8),
+                 value - (((value - qBlue(pixel)) * val + 0x80) >> 8),
+                 qAlpha(pixel));
+}
+
+inline QRgb overlayPixel(QRgb pixel, QRgb overlay)
+{
+    const int alpha = qAlpha(overlay);
+    return qRgba((alpha * qRed(overlay) + (0xff - alpha) * qRed(pixel)) >> 8,
+                 (alpha * qGreen(overlay) + (0xff - alpha) * qGreen(pixel)) >> 8,
+                 (alpha * qBlue(overlay) + (0xff - alpha) * qBlue(pixel)) >> 8,
+                 qMax(alpha, qAlpha(pixel)));
+}
+
+void toGrayScalar(QRgb *data, qsizetype count, int val)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        data[i] = grayPixel(data[i], val);
+    }
+}
+
+void colorizeScalar(QRgb *data, qsizetype count, const QRgb *table, int val)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        data[i] = colorizePixel(data[i], table, val);
+    }
+}
+
+void toMonochromeScalar(QRgb *data, qsizetype count, bool grayscale, int threshold, QRgb black, QRgb white, int val)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        data[i] = monochromePixel(data[i], grayscale, threshold, black, white, val);
+    }
+}
+
+void semiTransparentScalar(QRgb *data, qsizetype count)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        data[i] = semiTransparentPixel(data[i]);
+    }
+}
+
+void semiTransparentPremultipliedScalar(QRgb *data, qsizetype count)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        data[i] = semiTransparentPremultipliedPixel(data[i]);
+    }
+}
+
+void tintScalar(QRgb *data, qsizetype count, QRgb color)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        data[i] = tintPixel(data[i], color);
+    }
+}
+
+void tintPremultipliedScalar(QRgb *data, qsizetype count, QRgb color)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        data[i] = tintPremultipliedPixel(data[i], color);
+    }
+}
+
+void toGammaScalar(QRgb *data, qsizetype count, const QRgb *table)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        data[i] = gammaPixel(data[i], table);
+    }
+}
+
+void deSaturateScalar(QRgb *data, qsizetype count, int val)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        data[i] = deSaturatePixel(data[i], val);
+    }
+}
+
+void overlayScalar(QRgb *data, const QRgb *overlay, qsizetype count)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        data[i] = overlayPixel(data[i], overlay[i]);
+    }
+}
+
+void doublePixelsScalar(QRgb *destination, const QRgb *data, qsizetype count)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        destination[i * 2] = destination[i * 2 + 1] = data[i];
+    }
+}
+
+// The instruction sets, each vector holding one pixel per 32 bit lane.
+// mulSmall() is only defined for factors below 2^15.
+
+#ifdef KICONTHEMES_HAVE_AVX2
+struct Avx2 {
+    static constexpr int Size = 8;
+    using Vec = __m256i;
+
+    QT_FUNCTION_TARGET(AVX2) static Vec load(const QRgb *data)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+    }
+    QT_FUNCTION_TARGET(AVX2) static void store(QRgb *data, Vec v)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data), v);
+    }
+    QT_FUNCTION_TARGET(AVX2) static Vec set1(quint32 value)
+    {
+        return _mm256_set1_epi32(int(value));
+    }
+    template<int n>
+    QT_FUNCTION_TARGET(AVX2) static Vec srl(Vec v)
+    {
+        return _mm256_srli_epi32(v, n);
+    }
+    template<int n>
+    QT_FUNCTION_TARGET(AVX2) static Vec sll(Vec v)
+    {
+        return _mm256_slli_epi32(v, n);
+    }
+    QT_FUNCTION_TARGET(AVX2) static Vec bitAnd(Vec a, Vec b)
+    {
+        return _mm256_and_si256(a, b);
+    }
+    QT_FUNCTION_TARGET(AVX2) static Vec bitOr(Vec a, Vec b)
+    {
+        return _mm256_or_si256(a, b);
+    }
+    QT_FUNCTION_TARGET(AVX2) static Vec add(Vec a, Vec b)
+    {
+        return _mm256_add_epi32(a, b);
+    }
+    QT_FUNCTION_TARGET(AVX2) static Vec sub(Vec a, Vec b)
+    {
+        return _mm256_sub_epi32(a, b);
+    }
+    QT_FUNCTION_TARGET(AVX2) static Vec mulSmall(Vec a, Vec b)
+    {
+        return _mm256_madd_epi16(a, b);
+    }
+    QT_FUNCTION_TARGET(AVX2) static Vec greaterThan(Vec a, Vec b)
+    {
+        return _mm256_cmpgt_epi32(a, b);
+    }
+    QT_FUNCTION_TARGET(AVX2) static Vec select(Vec mask, Vec a, Vec b)
+    {
+        return _mm256_blendv_epi8(b, a, mask);
+    }
+    QT_FUNCTION_TARGET(AVX2) static Vec lookup(const QRgb *table, Vec index)
+    {
+        return _mm256_i32gather_epi32(reinterpret_cast<const int *>(table), index, 4);
+    }
+    // Every pixel twice, the first half into first, the second half into second
+    QT_FUNCTION_TARGET(AVX2) static void duplicate(Vec v, Vec &first, Vec &second)
+    {
+        const Vec low = _mm256_unpacklo_epi32(v, v);
+        const Vec high = _mm256_unpackhi_epi32(v, v);
+        first = _mm256_permute2x128_si256(low, high, 0x20);
+        second = _mm256_permute2x128_si256(low, high, 0x31);
+    }
+};
+#endif
+
+#if defined(__SSE2__)
+struct Sse2 {
+    static constexpr int Size = 4;
+    using Vec = __m128i;
+
+    static Vec load(const QRgb *data)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    }
+    static void store(QRgb *data, Vec v)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data), v);
+    }
+    static Vec set1(quint32 value)
+    {
+        return _mm_set1_epi32(int(value));
+    }
+    template<int n>
+    static Vec srl(Vec v)
+    {
+        return _mm_srli_epi32(v, n);
+    }
+    template<int n>
+    static Vec sll(Vec v)
+    {
+        return _mm_slli_epi32(v, n);
+    }
+    static Vec bitAnd(Vec a, Vec b)
+    {
+        return _mm_and_si128(a, b);
+    }
+    static Vec bitOr(Vec a, Vec b)
+    {
+        return _mm_or_si128(a, b);
+    }
+    static Vec add(Vec a, Vec b)
+    {
+        return _mm_add_epi32(a, b);
+    }
+    static Vec sub(Vec a, Vec b)
+    {
+        return _mm_sub_epi32(a, b);
+    }
+    static Vec mulSmall(Vec a, Vec b)
+    {
+        return _mm_madd_epi16(a, b);
+    }
+    static Vec greaterThan(Vec a, Vec b)
+    {
+        return _mm_cmpgt_epi32(a, b);
+    }
+    static Vec select(Vec mask, Vec a, Vec b)
+    {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+    static Vec lookup(const QRgb *table, Vec index)
+    {
+        alignas(16) quint32 indexes[Size];
+        _mm_store_si128(reinterpret_cast<__m128i *>(indexes), index);
+        return _mm_setr_epi32(int(table[indexes[0]]), int(table[indexes[1]]), int(table[indexes[2]]), int(table[indexes[3]]));
+    }
+    static void duplicate(Vec v, Vec &first, Vec &second)
+    {
+        first = _mm_unpacklo_epi32(v, v);
+        second = _mm_unpackhi_epi32(v, v);
+    }
+};
+#endif
+
+#if defined(__ARM_NEON)
+struct Neon {
+    static constexpr int Size = 4;
+    using Vec = uint32x4_t;
+
+    static Vec load(const QRgb *data)
+    {
+        return vld1q_u32(data);
+    }
+    static void store(QRgb *data, Vec v)
+    {
+        vst1q_u32(data, v);
+    }
+    static Vec set1(quint32 value)
+    {
+        return vdupq_n_u32(value);
+    }
+    template<int n>
+    static Vec srl(Vec v)
+    {
+        return vshrq_n_u32(v, n);
+    }
+    template<int n>
+    static Vec sll(Vec v)
+    {
+        return vshlq_n_u32(v, n);
+    }
+    static Vec bitAnd(Vec a, Vec b)
+    {
+        return vandq_u32(a, b);
+    }
+    static Vec bitOr(Vec a, Vec b)
+    {
+        return vorrq_u32(a, b);
+    }
+    static Vec add(Vec a, Vec b)
+    {
+        return vaddq_u32(a, b);
+    }
+    static Vec sub(Vec a, Vec b)
+    {
+        return vsubq_u32(a, b);
+    }
+    static Vec mulSmall(Vec a, Vec b)
+    {
+        return vmulq_u32(a, b);
+    }
+    static Vec greaterThan(Vec a, Vec b)
+    {
+        return vcgtq_u32(a, b);
+    }
+    static Vec select(Vec mask, Vec a, Vec b)
+    {
+        return vbslq_u32(mask, a, b);
+    }
+    static Vec lookup(const QRgb *table, Vec index)
+    {
+        const quint32 indexes[Size] = {vgetq_lane_u32(index, 0), vgetq_lane_u32(index, 1), vgetq_lane_u32(index, 2), vgetq_lane_u32(index, 3)};
+        const quint32 values[Size] = {table[indexes[0]], table[indexes[1]], table[indexes[2]], table[indexes[3]]};
+        return vld1q_u32(values);
+    }
+    static void duplicate(Vec v, Vec &first, Vec &second)
+    {
+        const uint32x4x2_t zipped = vzipq_u32(v, v);
+        first = zipped.val[0];
+        second = zipped.val[1];
+    }
+};
+#endif
+
+// The kernels, written once for all instruction sets
+
+template<typename V>
+struct Channels {
+    typename V::Vec red;
+    typename V::Vec green;
+    typename V::Vec blue;
+
+    KICONEFFECT_KERNEL_TARGET explicit Channels(typename V::Vec pixels)
+        : red(V::bitAnd(V::template srl<16>(pixels), V::set1(0xff)))
+        , green(V::bitAnd(V::template srl<8>(pixels), V::set1(0xff)))
+        , blue(V::bitAnd(pixels, V::set1(0xff)))
+    {
+    }
+
+    KICONEFFECT_KERNEL_TARGET Channels(typename V::Vec r, typename V::Vec g, typename V::Vec b)
+        : red(r)
+        , green(g)
+        , blue(b)
+    {
+    }
+
+    // qGray()
+    KICONEFFECT_KERNEL_TARGET typename V::Vec gray() const
+    {
+        const auto sum = V::add(V::add(V::mulSmall(red, V::set1(11)), V::template sll<4>(green)), V::mulSmall(blue, V::set1(5)));
+        return V::template srl<5>(sum);
+    }
+
+    // Combines the channels with the alpha channel of pixels
+    KICONEFFECT_KERNEL_TARGET typename V::Vec withAlphaOf(typename V::Vec pixels) const
+    {
+        return V::bitOr(V::bitAnd(pixels, V::set1(0xff000000)),
+                        V::bitOr(V::template sll<16>(red), V::bitOr(V::template sll<8>(green), blue)));
+    }
+};
+
+// blendPixel()
+template<typename V>
+KICONEFFECT_KERNEL_TARGET inline typename V::Vec blendVector(typename V::Vec pixels, const Channels<V> &target, int val)
+{
+    const Channels<V> channels(pixels);
+    const auto weight = V::set1(val);
+    const auto inverseWeight = V::set1(0xFF - val);
+    const Channels<V> blended(V::template srl<8>(V::add(V::mulSmall(weight, target.red), V::mulSmall(inverseWeight, channels.red))),
+                              V::template srl<8>(V::add(V::mulSmall(weight, target.green), V::mulSmall(inverseWeight, channels.green))),
+                              V::template srl<8>(V::add(V::mulSmall(weight, target.blue), V::mulSmall(inverseWeight, channels.blue))));
+    return blended.withAlphaOf(pixels);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET inline typename V::Vec maxVector(typename V::Vec a, typename V::Vec b)
+{
+    return V::select(V::greaterThan(a, b), a, b);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET void toGrayVector(QRgb *data, qsizetype count, int val)
+{
+    qsizetype i = 0;
+    for (; i + V::Size <= count; i += V::Size) {
+        const auto pixels = V::load(data + i);
+        const auto gray = Channels<V>(pixels).gray();
+        const Channels<V> target(gray, gray, gray);
+        V::store(data + i, val > 0xFF ? target.withAlphaOf(pixels) : blendVector<V>(pixels, target, val));
+    }
+    toGrayScalar(data + i, count - i, val);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET void colorizeVector(QRgb *data, qsizetype count, const QRgb *table, int val)
+{
+    qsizetype i = 0;
+    for (; i + V::Size <= count; i += V::Size) {
+        const auto pixels = V::load(data + i);
+        const Channels<V> target(V::lookup(table, Channels<V>(pixels).gray()));
+        V::store(data + i, blendVector<V>(pixels, target, val));
+    }
+    colorizeScalar(data + i, count - i, table, val);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET void toMonochromeVector(QRgb *data, qsizetype count, bool grayscale, int threshold, QRgb black, QRgb white, int val)
+{
+    const auto blackPixels = V::set1(black);
+    const auto whitePixels = V::set1(white);
+    const auto thresholds = V::set1(threshold);
+    qsizetype i = 0;
+    for (; i + V::Size <= count; i += V::Size) {
+        const auto pixels = V::load(data + i);
+        const Channels<V> channels(pixels);
+        const auto brighter = V::greaterThan(grayscale ? channels.red : channels.gray(), thresholds);
+        const Channels<V> target(V::select(brighter, whitePixels, blackPixels));
+        V::store(data + i, blendVector<V>(pixels, target, val));
+    }
+    toMonochromeScalar(data + i, count - i, grayscale, threshold, black, white, val);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET void semiTransparentVector(QRgb *data, qsizetype count)
+{
+    const auto colorMask = V::set1(0x00ffffff);
+    const auto alphaMask = V::set1(0x7f000000);
+    qsizetype i = 0;
+    for (; i + V::Size <= count; i += V::Size) {
+        const auto pixels = V::load(data + i);
+        V::store(data + i, V::bitOr(V::bitAnd(pixels, colorMask), V::bitAnd(V::template srl<1>(pixels), alphaMask)));
+    }
+    semiTransparentScalar(data + i, count - i);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET void semiTransparentPremultipliedVector(QRgb *data, qsizetype count)
+{
+    const auto mask = V::set1(0x7f7f7f7f);
+    qsizetype i = 0;
+    for (; i + V::Size <= count; i += V::Size) {
+        V::store(data + i, V::bitAnd(V::template srl<1>(V::load(data + i)), mask));
+    }
+    semiTransparentPremultipliedScalar(data + i, count - i);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET void tintVector(QRgb *data, qsizetype count, QRgb color)
+{
+    const auto colorPixels = V::set1(color & 0x00ffffff);
+    const auto alphaMask = V::set1(0xff000000);
+    qsizetype i = 0;
+    for (; i + V::Size <= count; i += V::Size) {
+        V::store(data + i, V::bitOr(V::bitAnd(V::load(data + i), alphaMask), colorPixels));
+    }
+    tintScalar(data + i, count - i, color);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET void tintPremultipliedVector(QRgb *data, qsizetype count, QRgb color)
+{
+    const Channels<V> target(V::set1(qRed(color)), V::set1(qGreen(color)), V::set1(qBlue(color)));
+    const auto half = V::set1(0x80);
+    qsizetype i = 0;
+    for (; i + V::Size <= count; i += V::Size) {
+        const auto pixels = V::load(data + i);
+        const auto alpha = V::template srl<24>(pixels);
+        const auto multiply = [&](typename V::Vec channel) KICONEFFECT_KERNEL_TARGET {
+            const auto t = V::mulSmall(channel, alpha);
+            return V::template srl<8>(V::add(V::add(t, V::template srl<8>(t)), half));
+        };
+        const Channels<V> tinted(multiply(target.red), multiply(target.green), multiply(target.blue));
+        V::store(data + i, tinted.withAlphaOf(pixels));
+    }
+    tintPremultipliedScalar(data + i, count - i, color);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET void toGammaVector(QRgb *data, qsizetype count, const QRgb *table)
+{
+    qsizetype i = 0;
+    for (; i + V::Size <= count; i += V::Size) {
+        const auto pixels = V::load(data + i);
+        const Channels<V> channels(pixels);
+        const Channels<V> mapped(V::lookup(table, channels.red), V::lookup(table, channels.green), V::lookup(table, channels.blue));
+        V::store(data + i, mapped.withAlphaOf(pixels));
+    }
+    toGammaScalar(data + i, count - i, table);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET void deSaturateVector(QRgb *data, qsizetype count, int val)
+{
+    const auto factor = V::set1(val);
+    const auto half = V::set1(0x80);
+    const auto scale = [&](typename V::Vec value, typename V::Vec channel) KICONEFFECT_KERNEL_TARGET {
+        return V::sub(value, V::template srl<8>(V::add(V::mulSmall(V::sub(value, channel), factor), half)));
+    };
+    qsizetype i = 0;
+    for (; i + V::Size <= count; i += V::Size) {
+        const auto pixels = V::load(data + i);
+        const Channels<V> channels(pixels);
+        const auto value = maxVector<V>(maxVector<V>(channels.red, channels.green), channels.blue);
+        const Channels<V> desaturated(scale(value, channels.red), scale(value, channels.green), scale(value, channels.blue));
+        V::store(data + i, desaturated.withAlphaOf(pixels));
+    }
+    deSaturateScalar(data + i, count - i, val);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET void overlayVector(QRgb *data, const QRgb *overlay, qsizetype count)
+{
+    const auto full = V::set1(0xff);
+    qsizetype i = 0;
+    for (; i + V::Size <= count; i += V::Size) {
+        const auto pixels = V::load(data + i);
+        const auto overlayPixels = V::load(overlay + i);
+        const Channels<V> channels(pixels);
+        const Channels<V> overlayChannels(overlayPixels);
+        const auto alpha = V::template srl<24>(overlayPixels);
+        const auto inverseAlpha = V::sub(full, alpha);
+        const auto blend = [&](typename V::Vec overlayChannel, typename V::Vec channel) KICONEFFECT_KERNEL_TARGET {
+            return V::template srl<8>(V::add(V::mulSmall(alpha, overlayChannel), V::mulSmall(inverseAlpha, channel)));
+        };
+        const Channels<V> blended(blend(overlayChannels.red, channels.red),
+                                  blend(overlayChannels.green, channels.green),
+                                  blend(overlayChannels.blue, channels.blue));
+        const auto pixelAlpha = V::template srl<24>(pixels);
+        const auto maxAlpha = V::select(V::greaterThan(alpha, pixelAlpha), alpha, pixelAlpha);
+        V::store(data + i, blended.withAlphaOf(V::template sll<24>(maxAlpha)));
+    }
+    overlayScalar(data + i, overlay + i, count - i);
+}
+
+template<typename V>
+KICONEFFECT_KERNEL_TARGET void doublePixelsVector(QRgb *destination, const QRgb *data, qsizetype count)
+{
+    qsizetype i = 0;
+    for (; i + V::Size <= count; i += V::Size) {
+        typename V::Vec first;
+        typename V::Vec second;
+        V::duplicate(V::load(data + i), first, second);
+        V::store(destination + i * 2, first);
+        V::store(destination + i * 2 + V::Size, second);
+    }
+    doublePixelsScalar(destination + i * 2, data + i, count - i);
+}
+
+template<typename V>
+constexpr KIconEffectKernels vectorKernels()
+{
+    return KIconEffectKernels{toGrayVector<V>,
+                              colorizeVector<V>,
+                              toMonochromeVector<V>,
+                              semiTransparentVector<V>,
+                              semiTransparentPremultipliedVector<V>,
+                              tintVector<V>,
+                              tintPremultipliedVector<V>,
+                              toGammaVector<V>,
+                              deSaturateVector<V>,
+                              overlayVector<V>,
+                              doublePixelsVector<V>};
+}
+
+} // namespace
+
+#endif // KICONEFFECT_SIMD_P_H
@@ -26,9 +26,12 @@
 
 // kdeui
 #include "debug.h"
+#include "kiconcatalog_p.h"
 #include "kiconcolors.h"
 #include "kiconeffect.h"
+#include "kiconeffect_p.h"
 #include "kicontheme.h"
+#include "kicontheme_p.h"
 
 #include <KColorScheme>
 #include <KCompressionDevice>
@@ -36,6 +39,7 @@
 #include <QBuffer>
 #include <QByteArray>
 #include <QDataStream>
+#include <QDateTime>
 #include <QDir>
 #include <QElapsedTimer>
 #include <QFileInfo>
@@ -44,54 +48,72 @@
 #include <QImage>
 #include <QMimeDatabase>
 #include <QMovie>
+#include <QMutex>
 #include <QPainter>
 #include <QPixmap>
 #include <QPixmapCache>
+#include <QSet>
 #include <QStringBuilder> // % operator for QString
+#include <QThreadPool>
+#include <QTimer>
 #include <QtGui/private/qiconloader_p.h>
 
 #include <qplatformdefs.h> //for readlink
 
+#include <algorithm>
+
 namespace
 {
 
-/**
- * Checks if name ends in one of the supported icon formats (i.e. .png)
- * and returns the name without the extension if it does.
- */
-QString removeIconExtension(const QString &name)
+KIconCatalog deduplicateIconsByName(const QStringList &icons)
 {
-    if (name.endsWith(QLatin1String(".png")) //
-        || name.endsWith(QLatin1String(".xpm")) //
-        || name.endsWith(QLatin1String(".svg"))) {
-        return name.left(name.length() - 4);
-    } else if (name.endsWith(QLatin1String(".svgz"))) {
-        return name.left(name.length() - 5);
+    // Eliminate duplicate entries (same icon in different directories)
+    KIconCatalog result;
+    result.reserve(icons.size());
+    QSet<QStringView> names; // views into icons
+    names.reserve(icons.size());
+    for (const auto &icon : icons) {
+        const QStringView name = removeIconExtension(QStringView(icon).mid(icon.lastIndexOf(QLatin1Char('/')) + 1));
+        if (!names.contains(name)) {
+            names.insert(name);
+            result.append(icon);
+        }
     }
-
-    return name;
+    return result;
 }
 
-QStringList deduplicateIconsByName(const QStringList &icons)
+/*
+ * Whether all visible pixels of image have about the same color, as symbolic
+ * icons do. Antialiased edges may differ a little, nearly transparent pixels
+ * don't count at all.
+ */
+bool isSingleColored(const QImage &image)
 {
-    // Eliminate duplicate entries (same icon in different directories)
-    QStringList result;
-    QStringList entries;
-    for (const auto &icon : icons) {
-        const int n = icon.lastIndexOf(QLatin1Char('/'));
-        QString name;
-        if (n == -1) {
-            name = icon;
-        } else {
-            name = icon.mid(n + 1);
-        }
-        name = removeIconExtension(name);
-        if (!entries.contains(name)) {
-            entries += name;
-            result += icon;
+    if (image.isNull() || !image.hasAlphaChannel()) {
+        return false;
+    }
+    const QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+    constexpr int minAlpha = 64;
+    constexpr int tolerance = 8;
+    bool found = false;
+    QRgb color = 0;
+    for (int y = 0; y < argb.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(argb.constScanLine(y));
+        for (int x = 0; x < argb.width(); ++x) {
+            if (qAlpha(line[x]) < minAlpha) {
+                continue;
+            }
+            if (!found) {
+                color = line[x];
+                found = true;
+            } else if (qAbs(qRed(line[x]) - qRed(color)) > tolerance //
+                       || qAbs(qGreen(line[x]) - qGreen(color)) > tolerance //
+                       || qAbs(qBlue(line[x]) - qBlue(color)) > tolerance) {
+                return false;
+            }
         }
     }
-    return result;
+    return true;
 }
 
 } // namespace
@@ -133,8 +155,7 @@ static QString paletteId(const KIconColors &colors)
 class KIconThemeNode
 {
 public:
-    KIconThemeNode(KIconTheme *_theme);
-    ~KIconThemeNode();
+    KIconThemeNode(std::shared_ptr<KIconTheme> _theme);
 
     KIconThemeNode(const KIconThemeNode &) = delete;
     KIconThemeNode &operator=(const KIconThemeNode &) = delete;
@@ -144,17 +165,16 @@ public:
     void queryIconsByContext(QStringList *lst, int size, KIconLoader::Context context) const;
     QString findIcon(const QString &name, int size, KIconLoader::MatchType match) const;
 
-    KIconTheme *theme;
-};
+    // Shared with the other loaders of the process, see sharedIconTheme()
+    std::shared_ptr<KIconTheme> theme;
 
-KIconThemeNode::KIconThemeNode(KIconTheme *_theme)
-{
-    theme = _theme;
-}
+    // Identifies the node for reuse across reconfigure, see KIconLoaderPrivate::createThemeNode()
+    QString key;
+};
 
-KIconThemeNode::~KIconThemeNode()
+KIconThemeNode::KIconThemeNode(std::shared_ptr<KIconTheme> _theme)
+    : theme(std::move(_theme))
 {
-    delete theme;
 }
 
 QStringList KIconThemeNode::queryIcons() const
@@ -179,9 +199,21 @@ QString KIconThemeNode::findIcon(const QString &name, int size, KIconLoader::Mat
     return theme->iconPath(name, size, match);
 }
 
+static QString themeNodeKey(const QString &themename, const QString &appname)
+{
+    // KIconTheme only looks into the application's directories for these themes
+    if (themename == KIconTheme::defaultThemeName() || themename == QLatin1String("hicolor") || themename == QLatin1String("locolor")) {
+        return themename + QLatin1Char('/') + appname;
+    }
+    return themename;
+}
+
 extern KICONTHEMES_EXPORT int kiconloader_ms_between_checks;
 KICONTHEMES_EXPORT int kiconloader_ms_between_checks = 5000;
 
+// How long to wait for more iconChanged broadcasts of the same burst, in ms
+static constexpr int s_changeDelay = 100;
+
 class KIconLoaderGlobalData : public QObject
 {
     Q_OBJECT
@@ -189,6 +221,11 @@ class KIconLoaderGlobalData : public QObject
 public:
     KIconLoaderGlobalData()
     {
+        // Changes often come in bursts, one per group, so handle them all at once.
+        // The broadcasts of a burst are not necessarily read from the bus at once.
+        m_changeTimer.setSingleShot(true);
+        m_changeTimer.setInterval(s_changeDelay);
+        connect(&m_changeTimer, &QTimer::timeout, this, &KIconLoaderGlobalData::flushIconChanges);
 #ifdef WITH_QTDBUS
         if (QDBusConnection::sessionBus().interface()) {
             QDBusConnection::sessionBus().connect(QString(),
@@ -196,7 +233,7 @@ public:
                                                   QStringLiteral("org.kde.KIconLoader"),
                                                   QStringLiteral("iconChanged"),
                                                   this,
-                                                  SIGNAL(iconChanged(int)));
+                                                  SLOT(scheduleIconChange(int)));
         }
 #endif
     }
@@ -223,9 +260,41 @@ public:
     }
 
 Q_SIGNALS:
-    void iconChanged(int group);
+    /*
+     * Emitted once for a burst of iconChanged broadcasts, with each changed group listed once.
+     */
+    void iconsChanged(const QList<int> &groups);
+
+private Q_SLOTS:
+    void scheduleIconChange(int group)
+    {
+        if (!m_pendingGroups.contains(group)) {
+            m_pendingGroups.append(group);
+        }
+        m_changeTimer.start();
+    }
 
 private:
+    void flushIconChanges()
+    {
+        const QList<int> groups = std::exchange(m_pendingGroups, {});
+        if (groups.isEmpty()) {
+            return;
+        }
+
+        KSharedConfig::Ptr sharedConfig = KSharedConfig::openConfig();
+        sharedConfig->reparseConfiguration();
+        const QString newThemeName = sharedConfig->group("Icons").readEntry("Theme", QStringLiteral("breeze"));
+        if (!newThemeName.isEmpty()) {
+            // NOTE Do NOT use QIcon::setThemeName here it makes Qt not use icon engine of the platform theme
+            //      anymore (KIconEngine on Plasma, which breaks recoloring) and overwrites a user set themeName
+            // TODO KF6 this should be done in the Plasma QPT
+            QIconLoader::instance()->updateSystemTheme();
+        }
+
+        Q_EMIT iconsChanged(groups);
+    }
+
     void loadGenericIcons()
     {
         if (m_loaded) {
@@ -242,6 +311,8 @@ private:
 private:
     QHash<QString, QString> m_genericIcons;
     bool m_loaded = false;
+    QTimer m_changeTimer;
+    QList<int> m_pendingGroups;
 };
 
 Q_GLOBAL_STATIC(KIconLoaderGlobalData, s_globalData)
@@ -250,14 +321,15 @@ KIconLoaderPrivate::KIconLoaderPrivate(const QString &_appname, const QStringLis
     : q(qq)
     , m_appname(_appname)
 {
-    q->connect(s_globalData, &KIconLoaderGlobalData::iconChanged, q, [this](int group) {
-        _k_refreshIcons(group);
+    q->connect(s_globalData, &KIconLoaderGlobalData::iconsChanged, q, [this](const QList<int> &groups) {
+        refreshIcons(groups);
     });
     init(m_appname, extraSearchPaths);
 }
 
 KIconLoaderPrivate::~KIconLoaderPrivate()
 {
+    cancelThemeSwitch();
     clear();
 }
 
@@ -273,6 +345,12 @@ void KIconLoaderPrivate::clear()
     qDeleteAll(links);
     mpGroups.clear();
     mPixmapCache.clear();
+    mCacheKeyKinds.clear();
+    mPathCache.clear();
+    mImageCache.clear();
+    mEmblemCache.clear();
+    mRecolorableFiles.clear();
+    mIconCatalogs.clear();
     m_appname.clear();
     searchPaths.clear();
     links.clear();
@@ -280,15 +358,14 @@ void KIconLoaderPrivate::clear()
     mThemesInTree.clear();
 }
 
-#if KICONTHEMES_BUILD_DEPRECATED_SINCE(6, 5)
-void KIconLoaderPrivate::drawOverlays(const KIconLoader *iconLoader, KIconLoader::Group group, int state, QPixmap &pix, const QStringList &overlays)
+bool KIconLoaderPrivate::drawOverlays(QImage &image, KIconLoader::Group group, int state, qreal scale, const QStringList &overlays, const KIconColors &colors)
 {
-    if (overlays.isEmpty()) {
-        return;
+    if (overlays.isEmpty() || image.isNull()) {
+        return false;
     }
 
-    const int width = pix.size().width();
-    const int height = pix.size().height();
+    const int width = image.width();
+    const int height = image.height();
     const int iconSize = qMin(width, height);
     int overlaySize;
 
@@ -304,8 +381,14 @@ void KIconLoaderPrivate::drawOverlays(const KIconLoader *iconLoader, KIconLoader
         overlaySize = 64;
     }
 
-    QPainter painter(&pix);
+    // QPainter can't paint on indexed images
+    if (image.depth() < 32) {
+        image.convertTo(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    QPainter painter(&image);
 
+    bool recolorable = false;
     int count = 0;
     for (const QString &overlay : overlays) {
         // Ensure empty strings fill up a emblem spot
@@ -319,15 +402,15 @@ void KIconLoaderPrivate::drawOverlays(const KIconLoader *iconLoader, KIconLoader
         // TODO: should we pass in the kstate? it results in a slower
         //      path, and perhaps emblems should remain in the default state
         //      anyways?
-        QPixmap pixmap = iconLoader->loadIcon(overlay, group, overlaySize, state, QStringList(), nullptr, true);
+        bool emblemRecolorable = false;
+        const QImage emblem = loadEmblemImage(overlay, group, overlaySize, state, colors, &emblemRecolorable);
+        recolorable |= emblemRecolorable;
 
-        if (pixmap.isNull()) {
+        if (emblem.isNull()) {
             continue;
         }
 
-        // match the emblem's devicePixelRatio to the original pixmap's
-        pixmap.setDevicePixelRatio(pix.devicePixelRatio());
-        const int margin = pixmap.devicePixelRatio() * 0.05 * iconSize;
+        const int margin = scale * 0.05 * iconSize;
 
         QPoint startPoint;
         switch (count) {
@@ -349,33 +432,251 @@ void KIconLoaderPrivate::drawOverlays(const KIconLoader *iconLoader, KIconLoader
             break;
         }
 
-        startPoint /= pix.devicePixelRatio();
-
-        painter.drawPixmap(startPoint, pixmap);
+        painter.drawImage(startPoint, emblem);
 
         ++count;
         if (count > 3) {
             break;
         }
     }
+
+    return recolorable;
+}
+
+QImage KIconLoaderPrivate::loadEmblemImage(const QString &name, KIconLoader::Group group, int size, int state, const KIconColors &colors, bool *recolorable)
+{
+    QString path;
+    if (QDir::isAbsolutePath(name)) {
+        path = name;
+    } else {
+        path = resolveIconPath(name, size, 1);
+        if (path.isEmpty()) {
+            path = q->iconPath(name, KIconLoader::User, true);
+        }
+    }
+
+    *recolorable = !path.isEmpty() && isRecolorable(path);
+    QString key = makeCacheKey(name, group, QStringList(), QSize(size, size), 1, state, colors, *recolorable);
+    if (const QImage *cachedEmblem = mEmblemCache.object(key)) {
+        return *cachedEmblem;
+    }
+
+    QImage emblem;
+    if (!path.isEmpty()) {
+        // The emblem cache keeps the result, the base image only helps the other states
+        emblem = loadBaseImage(path, QSize(size, size), 1, static_cast<KIconLoader::States>(state), colors, state != KIconLoader::DefaultState);
+        applyEffects(emblem, group, state);
+    }
+
+    // Rendering may have found out that the emblem can't be recolored after all
+    if (*recolorable && !isRecolorable(path)) {
+        *recolorable = false;
+        key = makeCacheKey(name, group, QStringList(), QSize(size, size), 1, state, colors, false);
+    }
+
+    // Also cache emblems that were not found, they are rechecked on the next reconfigure
+    mEmblemCache.insert(key, new QImage(emblem), emblem.width() * emblem.height() + 1);
+    return emblem;
+}
+
+void KIconLoaderPrivate::applyEffects(QImage &image, KIconLoader::Group group, int state) const
+{
+    // When changing the logic here also adapt makeCacheKey
+    if ((group == KIconLoader::Desktop || group == KIconLoader::Panel) && state == KIconLoader::ActiveState) {
+        KIconEffect::toActive(image);
+    }
+
+    if (state == KIconLoader::DisabledState && group >= 0 && group < KIconLoader::LastGroup) {
+        KIconEffect::toDisabled(image);
+    }
 }
-#endif
 
 void KIconLoaderPrivate::_k_refreshIcons(int group)
 {
-    KSharedConfig::Ptr sharedConfig = KSharedConfig::openConfig();
-    sharedConfig->reparseConfiguration();
-    const QString newThemeName = sharedConfig->group("Icons").readEntry("Theme", QStringLiteral("breeze"));
-    if (!newThemeName.isEmpty()) {
-        // NOTE Do NOT use QIcon::setThemeName here it makes Qt not use icon engine of the platform theme
-        //      anymore (KIconEngine on Plasma, which breaks recoloring) and overwrites a user set themeName
-        // TODO KF6 this should be done in the Plasma QPT
-        QIconLoader::instance()->updateSystemTheme();
+    refreshIcons({group});
+}
+
+void KIconLoaderPrivate::refreshIcons(const QList<int> &groups)
+{
+    // The global data already re-read the configuration for its own thread
+    if (q->thread() != s_globalData->thread()) {
+        KSharedConfig::openConfig()->reparseConfiguration();
+    }
+
+    // Only warm up the new theme if there is something to render and an event loop to deliver it
+    if (!mRecentRequests.isEmpty() && q->thread() == qApp->thread()) {
+        startThemeSwitch(groups);
+        return;
     }
 
     q->newIconLoader();
     mIconAvailability.clear();
-    Q_EMIT q->iconChanged(group);
+    for (int group : groups) {
+        Q_EMIT q->iconChanged(group);
+    }
+}
+
+/*
+ * Shared between a loader and the job warming up its new theme. The job only
+ * delivers its results while the loader is set, which is guarded by the mutex.
+ */
+struct KIconLoaderThemeSwitch {
+    QMutex mutex;
+    KIconLoader *loader;
+    // Tells the results of this switch apart from those of earlier ones still queued
+    quint64 generation;
+};
+
+void KIconLoaderPrivate::startThemeSwitch(const QList<int> &groups)
+{
+    // A switch that is still running would come up with an outdated theme
+    mThemeSwitchGroups = cancelThemeSwitch();
+    for (int group : groups) {
+        if (!mThemeSwitchGroups.contains(group)) {
+            mThemeSwitchGroups.append(group);
+        }
+    }
+
+    if (KIconLoader::global() == q) {
+        KIconTheme::reconfigure();
+    }
+    // Make sure the job only needs to read global state
+    (void)KIconTheme::current();
+    (void)s_globalData->genericIconFor(QString());
+
+    QList<IconRequest> requests;
+    const QStringList keys = mRecentRequests.keys();
+    requests.reserve(keys.size());
+    for (const QString &key : keys) {
+        requests.append(*mRecentRequests.object(key));
+    }
+
+    // Created in this thread, which it belongs to, but only used by the job. It must
+    // not refresh itself on icon changes meanwhile, and is deleted in this thread.
+    std::shared_ptr<KIconLoader> staging(new KIconLoader(m_appname, mExtraSearchPaths), [](KIconLoader *loader) {
+        loader->deleteLater();
+    });
+    QObject::disconnect(s_globalData, nullptr, staging.get(), nullptr);
+
+    mThemeSwitch = std::make_shared<KIconLoaderThemeSwitch>();
+    mThemeSwitch->loader = q;
+    mThemeSwitch->generation = ++mThemeSwitchGeneration;
+
+    QThreadPool::globalInstance()->start([themeSwitch = mThemeSwitch, staging, requests]() {
+        KIconLoaderPrivate *d = KIconLoaderPrivate::get(staging.get());
+        d->initIconThemes();
+
+        QList<WarmIcon> icons;
+        icons.reserve(requests.size());
+        for (const IconRequest &request : requests) {
+            {
+                QMutexLocker locker(&themeSwitch->mutex);
+                if (!themeSwitch->loader) {
+                    return;
+                }
+            }
+
+            WarmIcon icon;
+            bool recolorable = false;
+            icon.image = d->renderIcon(request.name,
+                                       request.group,
+                                       request.size,
+                                       request.scale,
+                                       request.state,
+                                       request.overlays,
+                                       request.colors,
+                                       request.canReturnNull,
+                                       request.favIconOverlay,
+                                       &icon.path,
+                                       &icon.themeIndex,
+                                       &recolorable);
+            icon.key = d->makeCacheKey(request.name, request.group, request.overlays, request.size, request.scale, request.state, request.colors, recolorable);
+            d->mCacheKeyKinds[request.name] |= recolorable ? KIconLoaderPrivate::KeyWithColors : KIconLoaderPrivate::KeyWithoutColors;
+            icon.scale = request.scale;
+            icons.append(icon);
+        }
+
+        QMutexLocker locker(&themeSwitch->mutex);
+        if (!themeSwitch->loader) {
+            return;
+        }
+        QMetaObject::invokeMethod(
+            themeSwitch->loader,
+            [loader = themeSwitch->loader, generation = themeSwitch->generation, staging, icons]() {
+                KIconLoaderPrivate::get(loader)->finishThemeSwitch(generation, staging.get(), icons);
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void KIconLoaderPrivate::finishThemeSwitch(quint64 generation, KIconLoader *stagingLoader, const QList<WarmIcon> &icons)
+{
+    // The switch may have been cancelled or replaced by a newer one after the results were queued
+    if (!mThemeSwitch || mThemeSwitch->generation != generation) {
+        return;
+    }
+    mThemeSwitch.reset();
+    KIconLoaderPrivate *staging = get(stagingLoader);
+
+    qDeleteAll(links);
+    links = std::exchange(staging->links, {});
+    mpThemeRoot = std::exchange(staging->mpThemeRoot, nullptr);
+    mThemesInTree = staging->mThemesInTree;
+    mpGroups = staging->mpGroups;
+    searchPaths = staging->searchPaths;
+    mExtraSearchPaths = staging->mExtraSearchPaths;
+    m_appname = staging->m_appname;
+    mIconThemeInited = staging->mIconThemeInited;
+    extraDesktopIconsLoaded = false;
+    mIconAvailability.clear();
+    mIconCatalogs.clear();
+
+    // The staging loader only holds what was looked up and rendered with the new theme
+    mPathCache.clear();
+    const QStringList pathKeys = staging->mPathCache.keys();
+    for (const QString &key : pathKeys) {
+        mPathCache.insert(key, new IconPathWithTheme(*staging->mPathCache.object(key)));
+    }
+    mImageCache.clear();
+    const QStringList imageKeys = staging->mImageCache.keys();
+    for (const QString &key : imageKeys) {
+        const QImage *image = staging->mImageCache.object(key);
+        mImageCache.insert(key, new QImage(*image), image->width() * image->height() + 1);
+    }
+    mEmblemCache.clear();
+    const QStringList emblemKeys = staging->mEmblemCache.keys();
+    for (const QString &key : emblemKeys) {
+        const QImage *emblem = staging->mEmblemCache.object(key);
+        mEmblemCache.insert(key, new QImage(*emblem), emblem->width() * emblem->height() + 1);
+    }
+    mRecolorableFiles = staging->mRecolorableFiles;
+    mCacheKeyKinds = staging->mCacheKeyKinds;
+
+    mPixmapCache.clear();
+    for (const WarmIcon &icon : icons) {
+        QPixmap pix = QPixmap::fromImage(icon.image);
+        pix.setDevicePixelRatio(icon.scale);
+        insertCachedPixmapWithPath(icon.key, pix, icon.path, icon.themeIndex);
+    }
+
+    qCDebug(KICONTHEMES) << "Switched icon theme with" << icons.size() << "icons rendered ahead";
+    Q_EMIT q->iconLoaderSettingsChanged();
+    const QList<int> groups = std::exchange(mThemeSwitchGroups, {});
+    for (int group : groups) {
+        Q_EMIT q->iconChanged(group);
+    }
+}
+
+QList<int> KIconLoaderPrivate::cancelThemeSwitch()
+{
+    if (!mThemeSwitch) {
+        return {};
+    }
+    QMutexLocker locker(&mThemeSwitch->mutex);
+    mThemeSwitch->loader = nullptr;
+    locker.unlock();
+    mThemeSwitch.reset();
+    return std::exchange(mThemeSwitchGroups, {});
 }
 
 bool KIconLoaderPrivate::shouldCheckForUnknownIcons()
@@ -396,8 +697,90 @@ KIconLoader::KIconLoader(const QString &appname, const QStringList &extraSearchP
 
 void KIconLoader::reconfigure(const QString &_appname, const QStringList &extraSearchPaths)
 {
-    d->clear();
-    d->init(_appname, extraSearchPaths);
+    // A theme switch still running would overwrite this configuration when it finishes
+    const QList<int> groups = d->cancelThemeSwitch();
+    d->reconfigure(_appname, extraSearchPaths);
+
+    // The switch was started for these changes, which are applied now as well
+    if (!groups.isEmpty()) {
+        Q_EMIT iconLoaderSettingsChanged();
+        for (int group : groups) {
+            Q_EMIT iconChanged(group);
+        }
+    }
+}
+
+void KIconLoaderPrivate::reconfigure(const QString &_appname, const QStringList &extraSearchPaths)
+{
+    // The old nodes are only deleted once the new tree is complete, so that
+    // new nodes can't end up at the address of an old one
+    const QList<KIconThemeNode *> oldLinks = std::exchange(links, {});
+    QList<KIconThemeNode *> unusedNodes;
+    for (KIconThemeNode *node : oldLinks) {
+        if (node->key.isEmpty() || mReusableNodes.contains(node->key)) {
+            unusedNodes.append(node);
+        } else {
+            mReusableNodes.insert(node->key, node);
+        }
+    }
+
+    const QString oldAppname = m_appname;
+    const QStringList oldSearchPaths = searchPaths;
+
+    mpGroups.clear();
+    mThemesInTree.clear();
+    mIconAvailability.clear();
+    mIconCatalogs.clear();
+    invalidateIconBaseDirs();
+    init(_appname, extraSearchPaths);
+    // Without an old tree there is nothing to compare, so stay lazy
+    if (!oldLinks.isEmpty()) {
+        initIconThemes();
+    }
+
+    // Nodes that were not reused belong to themes that changed or are not in the tree anymore
+    qDeleteAll(unusedNodes);
+    qDeleteAll(mReusableNodes);
+    mReusableNodes.clear();
+
+    // Icons are looked up in the order of links, so everything found in front
+    // of the first changed theme is still valid. Fallbacks and unknown icons
+    // are looked up again.
+    qsizetype unchangedThemes = 0;
+    while (unchangedThemes < links.size() && unchangedThemes < oldLinks.size() && links.at(unchangedThemes) == oldLinks.at(unchangedThemes)) {
+        ++unchangedThemes;
+    }
+
+    if (unchangedThemes == 0 || m_appname != oldAppname || searchPaths != oldSearchPaths) {
+        // The main theme decides about recoloring, and icons that are in no
+        // theme are looked up in the search paths
+        qCDebug(KICONTHEMES) << "Icon theme or search paths changed, clearing all caches";
+        mPixmapCache.clear();
+        mCacheKeyKinds.clear();
+        mPathCache.clear();
+        mImageCache.clear();
+        mEmblemCache.clear();
+        mRecolorableFiles.clear();
+        return;
+    }
+
+    qCDebug(KICONTHEMES) << "Keeping icons of" << unchangedThemes << "unchanged themes";
+    const QStringList pathKeys = mPathCache.keys();
+    for (const QString &key : pathKeys) {
+        if (mPathCache.object(key)->themeIndex >= unchangedThemes) {
+            mPathCache.remove(key);
+        }
+    }
+    const QStringList pixmapKeys = mPixmapCache.keys();
+    for (const QString &key : pixmapKeys) {
+        if (mPixmapCache.object(key)->themeIndex >= unchangedThemes) {
+            mPixmapCache.remove(key);
+        }
+    }
+    // Emblems are looked up by name and may be found in any theme
+    mEmblemCache.clear();
+    // Files are rendered again after reconfigure(), they may have been replaced
+    mImageCache.clear();
 }
 
 void KIconLoaderPrivate::init(const QString &_appname, const QStringList &extraSearchPaths)
@@ -407,26 +790,38 @@ void KIconLoaderPrivate::init(const QString &_appname, const QStringList &extraS
     mpThemeRoot = nullptr;
 
     searchPaths = extraSearchPaths;
+    mExtraSearchPaths = extraSearchPaths;
 
     m_appname = !_appname.isEmpty() ? _appname : QCoreApplication::applicationName();
 
-    // Cost here is number of pixels
-    mPixmapCache.setMaxCost(10 * 1024 * 1024);
+    // Insert application specific themes at the top.
+    searchPaths.append(m_appname + QStringLiteral("/pics"));
 
-    // These have to match the order in kiconloader.h
-    static const char *const groups[] = {"Desktop", "Toolbar", "MainToolbar", "Small", "Panel", "Dialog", nullptr};
+    // Add legacy icon dirs.
+    searchPaths.append(QStringLiteral("icons")); // was xdgdata-icon in KStandardDirs
+    // These are not in the icon spec, but e.g. GNOME puts some icons there anyway.
+    searchPaths.append(QStringLiteral("pixmaps")); // was xdgdata-pixmaps in KStandardDirs
 
-    // load default sizes
-    initIconThemes();
-    KIconTheme *defaultSizesTheme = links.empty() ? nullptr : links.first()->theme;
+    // Cost here is number of pixels
+    mPixmapCache.setMaxCost(10 * 1024 * 1024);
+    // Cost here is number of entries
+    mPathCache.setMaxCost(4096);
+    // Cost here is number of pixels, only the images of other states and of icons
+    // with overlays are kept, the plain icons are in the pixmap cache already
+    mImageCache.setMaxCost(1024 * 1024);
+    mEmblemCache.setMaxCost(256 * 1024);
+    // Cost here is number of entries
+    mRecentRequests.setMaxCost(128);
+
+    // load default sizes, the theme tree is only built by initIconThemes() once it is needed
+    QList<int> defaultSizes = iconThemeDefaultSizes(KIconTheme::current());
+    if (defaultSizes.isEmpty()) {
+        defaultSizes = iconThemeDefaultSizes(KIconTheme::defaultThemeName());
+    }
     mpGroups.resize(int(KIconLoader::LastGroup));
     for (KIconLoader::Group i = KIconLoader::FirstGroup; i < KIconLoader::LastGroup; ++i) {
-        if (groups[i] == nullptr) {
-            break;
-        }
-
-        if (defaultSizesTheme) {
-            mpGroups[i].size = defaultSizesTheme->defaultSize(i);
+        if (i < defaultSizes.size()) {
+            mpGroups[i].size = defaultSizes.at(i);
         }
     }
 }
@@ -439,31 +834,38 @@ void KIconLoaderPrivate::initIconThemes()
     // qCDebug(KICONTHEMES);
     mIconThemeInited = true;
 
+    // Construct the themes of the tree up front, addBaseThemes() links them in the order of the spec.
+    // Not needed on reconfigure, where the nodes of unchanged themes are reused.
+    if (mReusableNodes.isEmpty()) {
+        QStringList themeNames{KIconTheme::current(), QStringLiteral("hicolor")};
+        if (!QIcon::fallbackThemeName().isEmpty()) {
+            themeNames.insert(1, QIcon::fallbackThemeName());
+        }
+        mPrefetchedThemes = prefetchIconThemes(themeNames, m_appname);
+    }
+
     // Add the default theme and its base themes to the theme tree
-    KIconTheme *def = new KIconTheme(KIconTheme::current(), m_appname);
-    if (!def->isValid()) {
-        delete def;
+    mpThemeRoot = createThemeNode(KIconTheme::current(), m_appname);
+    if (!mpThemeRoot) {
         // warn, as this is actually a small penalty hit
         qCDebug(KICONTHEMES) << "Couldn't find current icon theme, falling back to default.";
-        def = new KIconTheme(KIconTheme::defaultThemeName(), m_appname);
-        if (!def->isValid()) {
+        mpThemeRoot = createThemeNode(KIconTheme::defaultThemeName(), m_appname);
+        if (!mpThemeRoot) {
             qCDebug(KICONTHEMES) << "Standard icon theme" << KIconTheme::defaultThemeName() << "not found!";
-            delete def;
+            mPrefetchedThemes.clear();
             return;
         }
     }
-    mpThemeRoot = new KIconThemeNode(def);
-    mThemesInTree.append(def->internalName());
+    mThemesInTree.append(mpThemeRoot->theme->internalName());
     links.append(mpThemeRoot);
     addBaseThemes(mpThemeRoot, m_appname);
 
-    // Insert application specific themes at the top.
-    searchPaths.append(m_appname + QStringLiteral("/pics"));
+    mPrefetchedThemes.clear();
 
-    // Add legacy icon dirs.
-    searchPaths.append(QStringLiteral("icons")); // was xdgdata-icon in KStandardDirs
-    // These are not in the icon spec, but e.g. GNOME puts some icons there anyway.
-    searchPaths.append(QStringLiteral("pixmaps")); // was xdgdata-pixmaps in KStandardDirs
+    // The theme may have turned out to be unusable after init() read the default sizes from it
+    for (KIconLoader::Group i = KIconLoader::FirstGroup; i < KIconLoader::LastGroup; ++i) {
+        mpGroups[i].size = mpThemeRoot->theme->defaultSize(i);
+    }
 }
 
 KIconLoader::~KIconLoader() = default;
@@ -475,20 +877,57 @@ QStringList KIconLoader::searchPaths() const
 
 void KIconLoader::addAppDir(const QString &appname, const QString &themeBaseDir)
 {
+    // A theme switch still running would drop the themes added here, so switch right away
+    const QList<int> groups = d->cancelThemeSwitch();
+    if (!groups.isEmpty()) {
+        newIconLoader();
+        for (int group : groups) {
+            Q_EMIT iconChanged(group);
+        }
+    }
+
     d->searchPaths.append(appname + QStringLiteral("/pics"));
     d->addAppThemes(appname, themeBaseDir);
 }
 
+KIconThemeNode *KIconLoaderPrivate::createThemeNode(const QString &themename, const QString &appname)
+{
+    // The themes prefetched by initIconThemes() were just looked up, don't check them again
+    std::shared_ptr<KIconTheme> theme = appname == m_appname ? mPrefetchedThemes.value(themename) : nullptr;
+    if (!theme) {
+        theme = sharedIconTheme(themename, appname);
+    }
+    if (!theme->isValid()) {
+        return nullptr;
+    }
+
+    // The registry hands out the same theme for as long as its files are unchanged
+    const QString key = themeNodeKey(themename, appname);
+    KIconThemeNode *oldNode = mReusableNodes.value(key);
+    if (oldNode && oldNode->theme == theme) {
+        return mReusableNodes.take(key);
+    }
+    KIconThemeNode *node = new KIconThemeNode(theme);
+    node->key = key;
+    return node;
+}
+
 void KIconLoaderPrivate::addAppThemes(const QString &appname, const QString &themeBaseDir)
 {
-    KIconTheme *def = new KIconTheme(QStringLiteral("hicolor"), appname, themeBaseDir);
+    // The application themes go after the main theme
+    initIconThemes();
+
+    std::shared_ptr<KIconTheme> def = sharedIconTheme(QStringLiteral("hicolor"), appname, themeBaseDir);
     if (!def->isValid()) {
-        delete def;
-        def = new KIconTheme(KIconTheme::defaultThemeName(), appname, themeBaseDir);
+        def = sharedIconTheme(KIconTheme::defaultThemeName(), appname, themeBaseDir);
     }
     KIconThemeNode *node = new KIconThemeNode(def);
     bool addedToLinks = false;
 
+    // New themes may provide icons that were resolved from the fallback search paths so far
+    mPathCache.clear();
+    mIconCatalogs.clear();
+
     if (!mThemesInTree.contains(appname)) {
         mThemesInTree.append(appname);
         links.append(node);
@@ -543,12 +982,10 @@ void KIconLoaderPrivate::addThemeByName(const QString &themename, const QString
     if (mThemesInTree.contains(themename + appname)) {
         return;
     }
-    KIconTheme *theme = new KIconTheme(themename, appname);
-    if (!theme->isValid()) {
-        delete theme;
+    KIconThemeNode *n = createThemeNode(themename, appname);
+    if (!n) {
         return;
     }
-    KIconThemeNode *n = new KIconThemeNode(theme);
     mThemesInTree.append(themename + appname);
     links.append(n);
     addInheritedThemes(n, appname);
@@ -559,14 +996,17 @@ void KIconLoaderPrivate::addExtraDesktopThemes()
     if (extraDesktopIconsLoaded) {
         return;
     }
+    initIconThemes();
 
     QStringList list;
-    const QStringList icnlibs = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QStringLiteral("icons"), QStandardPaths::LocateDirectory);
-    for (const auto &iconDir : icnlibs) {
-        QDir dir(iconDir);
-        if (!dir.exists()) {
+    const QList<IconBaseDir> baseDirs = iconBaseDirs();
+    for (const IconBaseDir &baseDir : baseDirs) {
+        if (std::none_of(baseDir.themes.cbegin(), baseDir.themes.cend(), [](const QString &theme) {
+                return theme.startsWith(QLatin1String("default."));
+            })) {
             continue;
         }
+        QDir dir(baseDir.path);
         const auto defaultEntries = dir.entryInfoList(QStringList(QStringLiteral("default.*")), QDir::Dirs);
         for (const auto &defaultEntry : defaultEntries) {
             if (!QFileInfo::exists(defaultEntry.filePath() + QLatin1String("/index.desktop")) //
@@ -590,13 +1030,30 @@ void KIconLoaderPrivate::addExtraDesktopThemes()
         addThemeByName(theme, QLatin1String(""));
     }
 
+    if (!list.isEmpty()) {
+        mPathCache.clear();
+        mIconCatalogs.clear();
+    }
+
     extraDesktopIconsLoaded = true;
 }
 
+#if KICONTHEMES_BUILD_DEPRECATED_SINCE(6, 5)
 void KIconLoader::drawOverlays(const QStringList &overlays, QPixmap &pixmap, KIconLoader::Group group, int state) const
 {
-    d->drawOverlays(this, group, state, pixmap, overlays);
+    if (overlays.isEmpty()) {
+        return;
+    }
+
+    const qreal dpr = pixmap.devicePixelRatio();
+    QImage image = pixmap.toImage();
+    // The overlays are placed in device pixels, the painter must not scale them once more
+    image.setDevicePixelRatio(1);
+    d->drawOverlays(image, group, state, dpr, overlays, d->mCustomColors ? d->mColors : KIconColors(qApp->palette()));
+    pixmap = QPixmap::fromImage(std::move(image));
+    pixmap.setDevicePixelRatio(dpr);
 }
+#endif
 
 void KIconLoaderPrivate::normalizeIconMetadata(KIconLoader::Group &group, QSize &size, int &state) const
 {
@@ -636,7 +1093,8 @@ QString KIconLoaderPrivate::makeCacheKey(const QString &name,
                                          const QSize &size,
                                          qreal scale,
                                          int state,
-                                         const KIconColors &colors) const
+                                         const KIconColors &colors,
+                                         bool recolorable) const
 {
     // The KSharedDataCache is shared so add some namespacing. The following code
     // uses QStringBuilder (new in Qt 4.6)
@@ -660,12 +1118,12 @@ QString KIconLoaderPrivate::makeCacheKey(const QString &name,
             % overlays.join(QLatin1Char('_'))
             % effectKey
             % QLatin1Char('_')
-            % paletteId(colors)
-            % (q->theme() && q->theme()->followsColorScheme() && state == KIconLoader::SelectedState ? QStringLiteral("_selected") : QString());
+            % (recolorable ? paletteId(colors) : QString())
+            % (recolorable && state == KIconLoader::SelectedState ? QStringLiteral("_selected") : QString());
     /* clang-format on */
 }
 
-QByteArray KIconLoaderPrivate::processSvg(const QString &path, KIconLoader::States state, const KIconColors &colors) const
+QByteArray KIconLoaderPrivate::processSvg(const QString &path, KIconLoader::States state, const KIconColors &colors, bool *foundStyleSheetOut) const
 {
     std::unique_ptr<QIODevice> device;
 
@@ -707,6 +1165,10 @@ QByteArray KIconLoaderPrivate::processSvg(const QString &path, KIconLoader::Stat
     }
     buffer.close();
 
+    if (foundStyleSheetOut) {
+        *foundStyleSheetOut = foundStyleSheet;
+    }
+
     return processedContents;
 }
 
@@ -715,9 +1177,12 @@ QImage KIconLoaderPrivate::createIconImage(const QString &path, const QSize &siz
     // TODO: metadata in the theme to make it do this only if explicitly supported?
     QImageReader reader;
     QBuffer buffer;
+    const bool tinted = isRasterSymbolic(path) && isRecolorable(path);
 
-    if (q->theme() && q->theme()->followsColorScheme() && (path.endsWith(QLatin1String("svg")) || path.endsWith(QLatin1String("svgz")))) {
-        buffer.setData(processSvg(path, state, colors));
+    if (!tinted && isRecolorable(path)) {
+        bool foundStyleSheet = false;
+        buffer.setData(processSvg(path, state, colors, &foundStyleSheet));
+        mRecolorableFiles.insert(path, foundStyleSheet);
         reader.setDevice(&buffer);
         reader.setFormat("svg");
     } else {
@@ -742,10 +1207,76 @@ QImage KIconLoaderPrivate::createIconImage(const QString &path, const QSize &siz
         reader.setScaledSize(finalSize);
     }
 
-    return reader.read();
+    QImage image = reader.read();
+    // The name alone doesn't make an icon single-colored, e.g. in themes that don't follow the color scheme
+    if (tinted && !image.isNull()) {
+        const bool singleColored = isSingleColored(image);
+        mRecolorableFiles.insert(path, singleColored);
+        if (singleColored) {
+            // The same colors the stylesheet of an SVG uses for ColorScheme-Text
+            KIconEffectPipeline().tint(state == KIconLoader::SelectedState ? colors.highlightedText() : colors.text()).apply(image);
+        }
+    }
+    return image;
 }
 
-void KIconLoaderPrivate::insertCachedPixmapWithPath(const QString &key, const QPixmap &data, const QString &path = QString())
+QImage KIconLoaderPrivate::loadBaseImage(const QString &path, const QSize &size, qreal scale, KIconLoader::States state, const KIconColors &colors, bool keep)
+{
+    // Only the stylesheet of recolorable icons depends on the colors, and it
+    // only differs for the selected state, see KIconColors::stylesheet()
+    const bool recolorable = isRecolorable(path);
+    const KIconLoader::States renderState = recolorable && state == KIconLoader::SelectedState ? KIconLoader::SelectedState : KIconLoader::DefaultState;
+
+    auto makeKey = [&](bool withColors) {
+        const QString colorsKey = withColors ? paletteId(colors) : QString();
+
+        /* clang-format off */
+        return path
+                % QLatin1Char('_')
+                % QString::number(size.width()) % QLatin1Char('x') % QString::number(size.height())
+                % QLatin1Char('@')
+                % QString::number(scale)
+                % QLatin1Char('_')
+                % colorsKey
+                % (withColors && renderState == KIconLoader::SelectedState ? QStringLiteral("_selected") : QString());
+        /* clang-format on */
+    };
+
+    if (const QImage *cachedImage = mImageCache.object(makeKey(recolorable))) {
+        return *cachedImage;
+    }
+
+    const QImage img = createIconImage(path, size, scale, renderState, colors);
+    if (!keep) {
+        return img;
+    }
+    // Rendering may have found out that the icon can't be recolored after all
+    mImageCache.insert(makeKey(recolorable && isRecolorable(path)), new QImage(img), img.width() * img.height() + 1);
+    return img;
+}
+
+bool KIconLoaderPrivate::isRasterSymbolic(const QString &path)
+{
+    return path.endsWith(QLatin1String("-symbolic.png"));
+}
+
+bool KIconLoaderPrivate::isRecolorable(const QString &path) const
+{
+    if (!q->theme() || !q->theme()->followsColorScheme()) {
+        return false;
+    }
+    if (isRasterSymbolic(path)) {
+        // Until the file has been read we have to assume that it is single-colored
+        return mRecolorableFiles.value(path, true);
+    }
+    if (!(path.endsWith(QLatin1String("svg")) || path.endsWith(QLatin1String("svgz")))) {
+        return false;
+    }
+    // Until the file has been processed we have to assume that it has a stylesheet
+    return mRecolorableFiles.value(path, true);
+}
+
+void KIconLoaderPrivate::insertCachedPixmapWithPath(const QString &key, const QPixmap &data, const QString &path, int themeIndex)
 {
     // Even if the pixmap is null, we add it to the caches so that we record
     // the fact that whatever icon led to us getting a null pixmap doesn't
@@ -754,6 +1285,7 @@ void KIconLoaderPrivate::insertCachedPixmapWithPath(const QString &key, const QP
     PixmapWithPath *pixmapPath = new PixmapWithPath;
     pixmapPath->pixmap = data;
     pixmapPath->path = path;
+    pixmapPath->themeIndex = themeIndex;
 
     mPixmapCache.insert(key, pixmapPath, data.width() * data.height() + 1);
 }
@@ -772,21 +1304,45 @@ bool KIconLoaderPrivate::findCachedPixmapWithPath(const QString &key, QPixmap &d
     return false;
 }
 
-QString KIconLoaderPrivate::findMatchingIconWithGenericFallbacks(const QString &name, int size, qreal scale) const
+QString KIconLoaderPrivate::findMatchingIconWithGenericFallbacks(const QString &name, int size, qreal scale, int *themeIndex) const
 {
-    QString path = findMatchingIcon(name, size, scale);
+    QString path = findMatchingIcon(name, size, scale, themeIndex);
     if (!path.isEmpty()) {
         return path;
     }
 
     const QString genericIcon = s_globalData()->genericIconFor(name);
     if (!genericIcon.isEmpty()) {
-        path = findMatchingIcon(genericIcon, size, scale);
+        path = findMatchingIcon(genericIcon, size, scale, themeIndex);
+    }
+    return path;
+}
+
+QString KIconLoaderPrivate::resolveIconPath(const QString &name, int size, qreal scale, int *themeIndex)
+{
+    const QString key = name % QLatin1Char('_') % QString::number(size) % QLatin1Char('@') % QString::number(scale);
+    if (const IconPathWithTheme *cachedPath = mPathCache.object(key)) {
+        if (themeIndex) {
+            *themeIndex = cachedPath->themeIndex;
+        }
+        return cachedPath->path;
+    }
+
+    // build the theme tree lazily
+    initIconThemes();
+
+    int foundIndex = AllThemesIndex;
+    const QString path = findMatchingIconWithGenericFallbacks(name, size, scale, &foundIndex);
+    if (!path.isEmpty()) {
+        mPathCache.insert(key, new IconPathWithTheme{path, foundIndex});
+    }
+    if (themeIndex) {
+        *themeIndex = foundIndex;
     }
     return path;
 }
 
-QString KIconLoaderPrivate::findMatchingIcon(const QString &name, int size, qreal scale) const
+QString KIconLoaderPrivate::findMatchingIcon(const QString &name, int size, qreal scale, int *themeIndex) const
 {
     // This looks for the exact match and its
     // generic fallbacks in each themeNode one after the other.
@@ -801,12 +1357,16 @@ QString KIconLoaderPrivate::findMatchingIcon(const QString &name, int size, qrea
     bool genericFallback = name.endsWith(QLatin1String("-x-generic"));
     bool isSymbolic = name.endsWith(QLatin1String("-symbolic"));
     QString path;
-    for (KIconThemeNode *themeNode : std::as_const(links)) {
+    for (int i = 0; i < links.size(); ++i) {
+        const KIconThemeNode *themeNode = links.at(i);
         QString currentName = name;
 
         while (!currentName.isEmpty()) {
             path = themeNode->theme->iconPathByName(currentName, size, KIconLoader::MatchBest, scale);
             if (!path.isEmpty()) {
+                if (themeIndex) {
+                    *themeIndex = i;
+                }
                 return path;
             }
 
@@ -826,6 +1386,9 @@ QString KIconLoaderPrivate::findMatchingIcon(const QString &name, int size, qrea
                 // "knotes" does exist, so let's check if a non-symbolic icon works before continuing.
                 path = themeNode->theme->iconPathByName(currentName, size, KIconLoader::MatchBest, scale);
                 if (!path.isEmpty()) {
+                    if (themeIndex) {
+                        *themeIndex = i;
+                    }
                     return path;
                 }
             }
@@ -911,8 +1474,9 @@ QString KIconLoaderPrivate::preferredIconPath(const QString &name)
     return path;
 }
 
-inline QString KIconLoaderPrivate::unknownIconPath(int size, qreal scale) const
+inline QString KIconLoaderPrivate::unknownIconPath(int size, qreal scale)
 {
+    initIconThemes();
     QString path = findMatchingIcon(QStringLiteral("unknown"), size, scale);
     if (path.isEmpty()) {
         qCDebug(KICONTHEMES) << "Warning: could not find \"unknown\" icon for size" << size << "at scale" << scale;
@@ -954,7 +1518,7 @@ QString KIconLoader::iconPath(const QString &_name, int group_or_size, bool canR
         return _name;
     }
 
-    QString name = removeIconExtension(_name);
+    QString name = removeIconExtension(_name).toString();
 
     QString path;
     if (group_or_size == KIconLoader::User) {
@@ -991,7 +1555,7 @@ QString KIconLoader::iconPath(const QString &_name, int group_or_size, bool canR
         }
     }
 
-    path = d->findMatchingIconWithGenericFallbacks(name, size, scale);
+    path = d->resolveIconPath(name, size, scale);
 
     if (path.isEmpty()) {
         // Try "User" group too.
@@ -1064,6 +1628,91 @@ QPixmap KIconLoader::loadScaledIcon(const QString &_name,
     return loadScaledIcon(_name, group, scale, size, state, overlays, path_store, canReturnNull, {});
 }
 
+QImage KIconLoaderPrivate::renderIcon(const QString &name,
+                                      KIconLoader::Group group,
+                                      const QSize &size,
+                                      qreal scale,
+                                      int state,
+                                      const QStringList &overlays,
+                                      const KIconColors &colors,
+                                      bool canReturnNull,
+                                      bool favIconOverlay,
+                                      QString *pathOut,
+                                      int *themeIndexOut,
+                                      bool *recolorable)
+{
+    const bool absolutePath = QDir::isAbsolutePath(name);
+    bool iconWasUnknown = false;
+    QString path;
+    int themeIndex = AllThemesIndex;
+
+    favIconOverlay = favIconOverlay && std::min(size.height(), size.width()) > 22;
+
+    // First we look for non-User icons. If we don't find one we'd search in
+    // the User space anyways...
+    if (group != KIconLoader::User) {
+        if (absolutePath && !favIconOverlay) {
+            path = name;
+            themeIndex = NoThemeIndex;
+        } else {
+            path = resolveIconPath(favIconOverlay ? QStringLiteral("text-html") : name, std::min(size.height(), size.width()), scale, &themeIndex);
+        }
+    }
+
+    if (path.isEmpty()) {
+        // We do have a "User" icon, or we couldn't find the non-User one.
+        path = (absolutePath) ? name : q->iconPath(name, KIconLoader::User, canReturnNull);
+        themeIndex = absolutePath ? NoThemeIndex : AllThemesIndex;
+    }
+
+    // Still can't find it? Use "unknown" if we can't return null.
+    // We keep going in the function so we can ensure this result gets cached.
+    if (path.isEmpty() && !canReturnNull) {
+        path = unknownIconPath(std::min(size.height(), size.width()), scale);
+        iconWasUnknown = true;
+        themeIndex = AllThemesIndex;
+    }
+
+    // All states share the same base image, the effects below detach from it
+    QImage img;
+    if (!path.isEmpty()) {
+        img = loadBaseImage(path, size, scale, static_cast<KIconLoader::States>(state), colors, state != KIconLoader::DefaultState || !overlays.isEmpty());
+    }
+
+    applyEffects(img, group, state);
+
+    if (favIconOverlay) {
+        QImage favIcon(name, "PNG");
+        if (!favIcon.isNull()) { // if favIcon not there yet, don't try to blend it
+            QPainter p(&img);
+
+            // Align the favicon overlay
+            QRect r(favIcon.rect());
+            r.moveBottomRight(img.rect().bottomRight());
+            r.adjust(-1, -1, -1, -1); // Move off edge
+
+            // Blend favIcon over img.
+            p.drawImage(r, favIcon);
+        }
+    }
+
+    *recolorable = !path.isEmpty() && isRecolorable(path);
+
+    // Compose the overlays before the single upload to the graphics card
+    *recolorable |= drawOverlays(img, group, state, scale, overlays, colors);
+
+    // Don't add the path to our unknown icon to the cache, only cache the
+    // actual image.
+    if (iconWasUnknown) {
+        path.clear();
+    }
+
+    *pathOut = path;
+    // The emblems are looked up in all themes, any change of the tree may affect them
+    *themeIndexOut = overlays.isEmpty() ? themeIndex : AllThemesIndex;
+    return img;
+}
+
 QPixmap KIconLoader::loadScaledIcon(const QString &_name,
                                     KIconLoader::Group group,
                                     qreal scale,
@@ -1103,7 +1752,7 @@ QPixmap KIconLoader::loadScaledIcon(const QString &_name,
     // we need to honor resource :/ paths and QDir::searchPaths => use QDir::isAbsolutePath, see bug 434451
     const bool absolutePath = QDir::isAbsolutePath(name);
     if (!absolutePath) {
-        name = removeIconExtension(name);
+        name = removeIconExtension(name).toString();
     }
 
     // Don't bother looking for an icon with no name.
@@ -1115,15 +1764,19 @@ QPixmap KIconLoader::loadScaledIcon(const QString &_name,
     // states.
     d->normalizeIconMetadata(group, size, state);
 
-    // See if the image is already cached.
+    // See if the image is already cached. Icons that can't be recolored are
+    // cached without the colors, so look for those first. Only the kinds of
+    // keys the name was rendered with are built, they are forgotten together
+    // with the pixmap cache.
     auto usedColors = colors ? *colors : d->mCustomColors ? d->mColors : KIconColors(qApp->palette());
-    QString key = d->makeCacheKey(name, group, overlays, size, scale, state, usedColors);
+    const quint8 keyKinds = d->mCacheKeyKinds.value(name);
     QPixmap pix;
-
-    bool iconWasUnknown = false;
     QString path;
 
-    if (d->findCachedPixmapWithPath(key, pix, path)) {
+    if (((keyKinds & KIconLoaderPrivate::KeyWithoutColors)
+         && d->findCachedPixmapWithPath(d->makeCacheKey(name, group, overlays, size, scale, state, usedColors, false), pix, path))
+        || ((keyKinds & KIconLoaderPrivate::KeyWithColors)
+            && d->findCachedPixmapWithPath(d->makeCacheKey(name, group, overlays, size, scale, state, usedColors, true), pix, path))) {
         if (path_store) {
             *path_store = path;
         }
@@ -1140,75 +1793,18 @@ QPixmap KIconLoader::loadScaledIcon(const QString &_name,
     }
 
     // Image is not cached... go find it and apply effects.
-
-    favIconOverlay = favIconOverlay && std::min(size.height(), size.width()) > 22;
-
-    // First we look for non-User icons. If we don't find one we'd search in
-    // the User space anyways...
-    if (group != KIconLoader::User) {
-        if (absolutePath && !favIconOverlay) {
-            path = name;
-        } else {
-            path = d->findMatchingIconWithGenericFallbacks(favIconOverlay ? QStringLiteral("text-html") : name, std::min(size.height(), size.width()), scale);
-        }
-    }
-
-    if (path.isEmpty()) {
-        // We do have a "User" icon, or we couldn't find the non-User one.
-        path = (absolutePath) ? name : iconPath(name, KIconLoader::User, canReturnNull);
-    }
-
-    // Still can't find it? Use "unknown" if we can't return null.
-    // We keep going in the function so we can ensure this result gets cached.
-    if (path.isEmpty() && !canReturnNull) {
-        path = d->unknownIconPath(std::min(size.height(), size.width()), scale);
-        iconWasUnknown = true;
-    }
-
-    QImage img;
-    if (!path.isEmpty()) {
-        img = d->createIconImage(path, size, scale, static_cast<KIconLoader::States>(state), usedColors);
-    }
-
-    // apply effects. When changing the logic here also adapt makeCacheKey
-    if ((group == KIconLoader::Desktop || group == KIconLoader::Panel) && state == KIconLoader::ActiveState) {
-        KIconEffect::toActive(img);
-    }
-
-    if (state == KIconLoader::DisabledState && group >= 0 && group < KIconLoader::LastGroup) {
-        KIconEffect::toDisabled(img);
-    }
-
-    if (favIconOverlay) {
-        QImage favIcon(name, "PNG");
-        if (!favIcon.isNull()) { // if favIcon not there yet, don't try to blend it
-            QPainter p(&img);
-
-            // Align the favicon overlay
-            QRect r(favIcon.rect());
-            r.moveBottomRight(img.rect().bottomRight());
-            r.adjust(-1, -1, -1, -1); // Move off edge
-
-            // Blend favIcon over img.
-            p.drawImage(r, favIcon);
-        }
-    }
-
-    pix = QPixmap::fromImage(std::move(img));
+    int themeIndex = KIconLoaderPrivate::AllThemesIndex;
+    bool recolorable = false;
+    pix = QPixmap::fromImage(d->renderIcon(name, group, size, scale, state, overlays, usedColors, canReturnNull, favIconOverlay, &path, &themeIndex, &recolorable));
     pix.setDevicePixelRatio(scale);
 
-    // TODO: If we make a loadIcon that returns the image we can convert
-    // drawOverlays to use the image instead of pixmaps as well so we don't
-    // have to transfer so much to the graphics card.
-    d->drawOverlays(this, group, state, pix, overlays);
+    const QString key = d->makeCacheKey(name, group, overlays, size, scale, state, usedColors, recolorable);
+    d->insertCachedPixmapWithPath(key, pix, path, themeIndex);
+    d->mCacheKeyKinds[name] |= recolorable ? KIconLoaderPrivate::KeyWithColors : KIconLoaderPrivate::KeyWithoutColors;
 
-    // Don't add the path to our unknown icon to the cache, only cache the
-    // actual image.
-    if (iconWasUnknown) {
-        path.clear();
-    }
-
-    d->insertCachedPixmapWithPath(key, pix, path);
+    // Remember the request, so that the icon can be rendered ahead of a theme switch.
+    // Cached icons were recorded when they were first rendered, the records outlive switches.
+    d->mRecentRequests.insert(key, new IconRequest{name, group, size, scale, state, overlays, usedColors, canReturnNull, favIconOverlay});
 
     if (path_store) {
         *path_store = path;
@@ -1264,6 +1860,7 @@ QString KIconLoader::moviePath(const QString &name, KIconLoader::Group group, in
 
         QString path;
 
+        d->initIconThemes();
         for (KIconThemeNode *themeNode : std::as_const(d->links)) {
             path = themeNode->theme->iconPath(file, size, KIconLoader::MatchExact);
             if (!path.isEmpty()) {
@@ -1341,8 +1938,9 @@ QStringList KIconLoader::loadAnimated(const QString &name, KIconLoader::Group gr
 
 KIconTheme *KIconLoader::theme() const
 {
+    d->initIconThemes();
     if (d->mpThemeRoot) {
-        return d->mpThemeRoot->theme;
+        return d->mpThemeRoot->theme.get();
     }
     return nullptr;
 }
@@ -1374,6 +1972,8 @@ QStringList KIconLoader::queryIconsByDir(const QString &iconsDir) const
 
 QStringList KIconLoader::queryIconsByContext(int group_or_size, KIconLoader::Context context) const
 {
+    d->initIconThemes();
+
     QStringList result;
     if (group_or_size >= KIconLoader::LastGroup) {
         qCDebug(KICONTHEMES) << "Invalid icon group:" << group_or_size;
@@ -1386,23 +1986,33 @@ QStringList KIconLoader::queryIconsByContext(int group_or_size, KIconLoader::Con
         size = -group_or_size;
     }
 
+    const QString catalogKey = QLatin1String("bycontext_") + QString::number(size) + QLatin1Char('_') + QString::number(context);
+    if (const auto it = d->mIconCatalogs.constFind(catalogKey); it != d->mIconCatalogs.constEnd()) {
+        return it->toStringList();
+    }
+
     for (KIconThemeNode *themeNode : std::as_const(d->links)) {
         themeNode->queryIconsByContext(&result, size, context);
     }
 
-    return deduplicateIconsByName(result);
+    return d->mIconCatalogs.insert(catalogKey, deduplicateIconsByName(result))->toStringList();
 }
 
 QStringList KIconLoader::queryIcons() const
 {
     d->initIconThemes();
 
+    const QString catalogKey = QStringLiteral("all");
+    if (const auto it = d->mIconCatalogs.constFind(catalogKey); it != d->mIconCatalogs.constEnd()) {
+        return it->toStringList();
+    }
+
     QStringList result;
     for (const auto &themeNode : std::as_const(d->links)) {
         result.append(themeNode->queryIcons());
     }
 
-    return deduplicateIconsByName(result);
+    return d->mIconCatalogs.insert(catalogKey, deduplicateIconsByName(result))->toStringList();
 }
 
 QStringList KIconLoader::queryIcons(int group_or_size, KIconLoader::Context context) const
@@ -1421,16 +2031,70 @@ QStringList KIconLoader::queryIcons(int group_or_size, KIconLoader::Context cont
         size = -group_or_size;
     }
 
+    const QString catalogKey = QLatin1String("bysize_") + QString::number(size) + QLatin1Char('_') + QString::number(context);
+    if (const auto it = d->mIconCatalogs.constFind(catalogKey); it != d->mIconCatalogs.constEnd()) {
+        return it->toStringList();
+    }
+
     for (KIconThemeNode *themeNode : std::as_const(d->links)) {
         themeNode->queryIcons(&result, size, context);
     }
 
-    return deduplicateIconsByName(result);
+    return d->mIconCatalogs.insert(catalogKey, deduplicateIconsByName(result))->toStringList();
+}
+
+void KIconLoader::forEachIcon(const std::function<bool(const IconEntry &)> &callback) const
+{
+    d->initIconThemes();
+
+    // Eliminate duplicate entries (same icon in different directories)
+    QSet<QString> names;
+    auto reportNew = [&names, &callback](const IconEntry &entry) {
+        if (names.contains(entry.name)) {
+            return true;
+        }
+        names.insert(entry.name);
+        return callback(entry);
+    };
+
+    for (KIconThemeNode *themeNode : std::as_const(d->links)) {
+        if (!themeNode->theme->forEachIcon(reportNew)) {
+            return;
+        }
+    }
+}
+
+void KIconLoader::forEachIcon(int group_or_size, KIconLoader::Context context, const std::function<bool(const IconEntry &)> &callback) const
+{
+    d->initIconThemes();
+
+    if (group_or_size >= KIconLoader::LastGroup) {
+        qCDebug(KICONTHEMES) << "Invalid icon group:" << group_or_size;
+        return;
+    }
+    const int size = group_or_size >= 0 ? d->mpGroups[group_or_size].size : -group_or_size;
+
+    // Eliminate duplicate entries (same icon in different directories)
+    QSet<QString> names;
+    auto reportNew = [&names, &callback](const IconEntry &entry) {
+        if (names.contains(entry.name)) {
+            return true;
+        }
+        names.insert(entry.name);
+        return callback(entry);
+    };
+
+    for (KIconThemeNode *themeNode : std::as_const(d->links)) {
+        if (!themeNode->theme->forEachIcon(size, context, reportNew)) {
+            return;
+        }
+    }
 }
 
 // used by KIconDialog to find out which contexts to offer in a combobox
 bool KIconLoader::hasContext(KIconLoader::Context context) const
 {
+    d->initIconThemes();
     for (KIconThemeNode *themeNode : std::as_const(d->links)) {
         if (themeNode->theme->hasContext(context)) {
             return true;
@@ -1503,7 +2167,10 @@ void KIconLoader::newIconLoader()
         KIconTheme::reconfigure();
     }
 
-    reconfigure(objectName());
+    // The same configuration the theme switch builds its tree with
+    const QString appname = d->m_appname;
+    const QStringList extraSearchPaths = d->mExtraSearchPaths;
+    reconfigure(appname, extraSearchPaths);
     Q_EMIT iconLoaderSettingsChanged();
 }
 
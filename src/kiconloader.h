@@ -14,6 +14,7 @@
 #include <QSize>
 #include <QString>
 #include <QStringList>
+#include <functional>
 #include <memory>
 
 #if __has_include(<optional>) && __cplusplus >= 201703L
@@ -625,6 +626,60 @@ public:
      */
     QStringList queryIconsByContext(int group_or_size, KIconLoader::Context context = KIconLoader::Any) const;
 
+    /*!
+     * \struct KIconLoader::IconEntry
+     * \inmodule KIconThemes
+     *
+     * \brief An icon reported by forEachIcon().
+     *
+     * \since 6.30
+     */
+    struct IconEntry {
+        /*!
+         * The name of the icon, without extension.
+         */
+        QString name;
+        /*!
+         * The absolute path of the icon file.
+         */
+        QString path;
+        /*!
+         * The nominal size of the theme directory the icon is in.
+         */
+        int size;
+        /*!
+         * The context of the theme directory the icon is in.
+         */
+        KIconLoader::Context context;
+    };
+
+    /*!
+     * Calls \a callback for every available icon, like queryIcons() but
+     * without building the list first: the theme directories are read one
+     * after the other and their icons are reported as they are found.
+     * Icons whose name was already reported by an earlier theme are skipped.
+     *
+     * The enumeration stops early when \a callback returns \c false.
+     *
+     * \since 6.30
+     */
+    void forEachIcon(const std::function<bool(const IconEntry &)> &callback) const;
+
+    /*!
+     * Calls \a callback for every available icon of a specific group or size,
+     * having a specific context. This is the streaming variant of
+     * queryIcons(int, KIconLoader::Context), see forEachIcon() for the details.
+     *
+     * \a group_or_size If positive, search icons whose size is
+     * specified by the icon group \a group_or_size. If negative, search
+     * icons whose size is - \a group_or_size.
+     *
+     * \a context The icon context.
+     *
+     * \since 6.30
+     */
+    void forEachIcon(int group_or_size, KIconLoader::Context context, const std::function<bool(const IconEntry &)> &callback) const;
+
     /*!
      * \internal
      */
@@ -685,7 +740,9 @@ public:
     /*!
      * Reconfigure the icon loader, for instance to change the associated app name or extra search paths.
      *
-     * This also clears the in-memory pixmap cache (even if the appname didn't change, which is useful for unittests)
+     * Themes whose index file did not change are kept, and so are the cached icons found in
+     * them, unless a theme that is searched before them changed. Unknown icons and icons
+     * that were not found in any theme are looked up again.
      *
      * \a appname the application name (empty for the global iconloader)
      *
@@ -794,6 +851,10 @@ Q_SIGNALS:
     /*!
      * Emitted when the system icon theme changes
      *
+     * The new theme is loaded in the background, and the most recently used
+     * icons are rendered with it before this signal is emitted. Until then
+     * the icons of the previous theme are returned.
+     *
      * \since 5.0
      */
     void iconChanged(int group);
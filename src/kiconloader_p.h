@@ -11,16 +11,23 @@
 
 #include <QCache>
 #include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
 #include <QPixmap>
 #include <QSize>
 #include <QString>
 #include <QStringList>
 
+#include "kiconcatalog_p.h"
 #include "kiconcolors.h"
 #include "kiconeffect.h"
 #include "kiconloader.h"
 
+#include <limits>
+#include <memory>
+
 class KIconThemeNode;
+struct KIconLoaderThemeSwitch;
 
 /* KIconGroup: Icon type description. */
 
@@ -34,6 +41,42 @@ struct KIconGroup {
 struct PixmapWithPath {
     QPixmap pixmap;
     QString path;
+    int themeIndex;
+};
+
+/*
+ * An icon path found in the theme tree, along with the index of the theme node it was found in.
+ */
+struct IconPathWithTheme {
+    QString path;
+    int themeIndex;
+};
+
+/*
+ * The normalized arguments of a KIconLoader::loadScaledIcon() call, so that
+ * recently used icons can be rendered again ahead of a theme switch.
+ */
+struct IconRequest {
+    QString name;
+    KIconLoader::Group group;
+    QSize size;
+    qreal scale;
+    int state;
+    QStringList overlays;
+    KIconColors colors;
+    bool canReturnNull;
+    bool favIconOverlay;
+};
+
+/*
+ * An icon rendered by the new theme during a theme switch, together with its pixmap cache entry.
+ */
+struct WarmIcon {
+    QString key;
+    QImage image;
+    qreal scale;
+    QString path;
+    int themeIndex;
 };
 
 class KIconLoaderPrivate
@@ -48,20 +91,35 @@ public:
 
     void init(const QString &_appname, const QStringList &extraSearchPaths = QStringList());
 
+    /*
+     * Rebuilds the theme tree, reusing the nodes of themes that did not change.
+     * Cached icons are only dropped if a theme in front of the one they were
+     * found in changed.
+     */
+    void reconfigure(const QString &_appname, const QStringList &extraSearchPaths);
+
     void initIconThemes();
 
     /*
      * tries to find an icon with the name. It tries some extension and
-     * match strategies
+     * match strategies. The caller has to build the theme tree with
+     * initIconThemes() first.
      */
-    QString findMatchingIcon(const QString &name, int size, qreal scale) const;
+    QString findMatchingIcon(const QString &name, int size, qreal scale, int *themeIndex = nullptr) const;
 
     /*
      * tries to find an icon with the name.
      * This is one layer above findMatchingIcon -- it also implements generic fallbacks
      * such as generic icons for mimetypes.
      */
-    QString findMatchingIconWithGenericFallbacks(const QString &name, int size, qreal scale) const;
+    QString findMatchingIconWithGenericFallbacks(const QString &name, int size, qreal scale, int *themeIndex = nullptr) const;
+
+    /*
+     * Same as findMatchingIconWithGenericFallbacks, but consults the path cache
+     * first. Only icons that were found are cached, so that unknown icons
+     * are searched for anew.
+     */
+    QString resolveIconPath(const QString &name, int size, qreal scale, int *themeIndex = nullptr);
 
     /*
      * returns the preferred icon path for an icon with the name.
@@ -70,6 +128,13 @@ public:
      */
     QString preferredIconPath(const QString &name);
 
+    /*
+     * Creates the node for the theme \a themename, reusing the node from before
+     * the last reconfigure if the theme did not change since.
+     * Returns nullptr if there is no valid theme of that name.
+     */
+    KIconThemeNode *createThemeNode(const QString &themename, const QString &appname);
+
     /*
      * Adds themes installed in the application's directory.
      **/
@@ -103,7 +168,7 @@ public:
     /*
      * return the path for the unknown icon in that size
      */
-    QString unknownIconPath(int size, qreal scale) const;
+    QString unknownIconPath(int size, qreal scale);
 
     /*
      * Used with KIconLoader::loadIcon to convert the given name, size, group,
@@ -115,6 +180,8 @@ public:
     /*
      * Used with KIconLoader::loadIcon to get a base key name from the given
      * icon metadata. Ensure the metadata is normalized first.
+     * The colors are only part of the key if \a recolorable is true, so that
+     * other icons survive palette changes.
      */
     QString makeCacheKey(const QString &name,
                          KIconLoader::Group group,
@@ -122,7 +189,8 @@ public:
                          const QSize &size,
                          qreal scale,
                          int state,
-                         const KIconColors &colors) const;
+                         const KIconColors &colors,
+                         bool recolorable) const;
 
     /*
      * If the icon is an SVG file, process it generating a stylesheet
@@ -130,19 +198,46 @@ public:
      * as text color, background color, highlight color, positive/neutral/negative color
      * \sa KColorScheme
      */
-    QByteArray processSvg(const QString &path, KIconLoader::States state, const KIconColors &colors) const;
+    QByteArray processSvg(const QString &path, KIconLoader::States state, const KIconColors &colors, bool *foundStyleSheet = nullptr) const;
 
     /*
      * Creates the QImage for \apath, using SVG rendering as appropriate.
      * \a size is only used for scalable images, but if non-zero non-scalable
-     * images will be resized anyways.
+     * images will be resized anyways. Recolorable raster icons are tinted
+     * with the text color of \a colors.
      */
     QImage createIconImage(const QString &path, const QSize &size, qreal scale, KIconLoader::States state, const KIconColors &colors);
 
+    /*
+     * Returns the image for \a path without any state effects applied, from the
+     * image cache if possible. The active and disabled states are derived from
+     * this image, so the file is only read and decoded once for all states.
+     *
+     * The image is only kept when \a keep is set: the pixmap cache already holds
+     * the plain icons, so it is only worth its memory for the other states and
+     * for icons with overlays.
+     */
+    QImage loadBaseImage(const QString &path, const QSize &size, qreal scale, KIconLoader::States state, const KIconColors &colors, bool keep);
+
+    /*
+     * Whether the stylesheet of \a path gets replaced to follow the color scheme.
+     * SVGs that turned out to have no "current-color-scheme" stylesheet are not recolorable.
+     * Symbolic PNGs are recolorable as well, see isRasterSymbolic(), unless they
+     * turned out to have more than one color.
+     */
+    bool isRecolorable(const QString &path) const;
+
+    /*
+     * Whether \a path is a PNG following the "-symbolic" naming of single-colored
+     * icons. Such icons only carry their shape in the alpha channel, so they
+     * can follow the color scheme by being tinted instead of through a stylesheet.
+     */
+    static bool isRasterSymbolic(const QString &path);
+
     /*
      * Adds an QPixmap with its associated path to the shared icon cache.
      */
-    void insertCachedPixmapWithPath(const QString &key, const QPixmap &data, const QString &path);
+    void insertCachedPixmapWithPath(const QString &key, const QPixmap &data, const QString &path, int themeIndex);
 
     /*
      * Retrieves the path and pixmap of the given key from the shared
@@ -160,6 +255,49 @@ public:
      */
     void _k_refreshIcons(int group);
 
+    /*
+     * Rebuilds the theme tree once for a burst of changes, then emits
+     * KIconLoader::iconChanged once for each of the \a groups.
+     */
+    void refreshIcons(const QList<int> &groups);
+
+    /*
+     * Builds the new theme tree and renders the recently used icons with it
+     * in a thread pool, while this loader keeps serving the old theme.
+     * finishThemeSwitch() then swaps them in.
+     */
+    void startThemeSwitch(const QList<int> &groups);
+
+    /*
+     * Takes over the theme tree and caches of \a staging, adds the \a icons
+     * rendered with it to the pixmap cache and announces the change. Results
+     * of a switch other than the current one, \a generation, are dropped.
+     */
+    void finishThemeSwitch(quint64 generation, KIconLoader *staging, const QList<WarmIcon> &icons);
+
+    /*
+     * Makes a running theme switch discard its results.
+     * Returns the groups the switch was started for, which are not announced anymore.
+     */
+    QList<int> cancelThemeSwitch();
+
+    /*
+     * Looks up and renders the icon for a loadScaledIcon() call that missed the pixmap cache.
+     * The metadata must be normalized already.
+     */
+    QImage renderIcon(const QString &name,
+                      KIconLoader::Group group,
+                      const QSize &size,
+                      qreal scale,
+                      int state,
+                      const QStringList &overlays,
+                      const KIconColors &colors,
+                      bool canReturnNull,
+                      bool favIconOverlay,
+                      QString *path,
+                      int *themeIndex,
+                      bool *recolorable);
+
     bool shouldCheckForUnknownIcons();
 
     KIconLoader *const q;
@@ -168,23 +306,76 @@ public:
     std::vector<KIconGroup> mpGroups;
     KIconThemeNode *mpThemeRoot = nullptr;
     QStringList searchPaths;
+    // The search paths passed to init(), the theme switch builds its tree with them
+    QStringList mExtraSearchPaths;
 #if KICONTHEMES_BUILD_DEPRECATED_SINCE(6, 5)
     KIconEffect mpEffect;
 #endif
     QList<KIconThemeNode *> links;
 
+    // The nodes of the previous theme tree during reconfigure(), see createThemeNode()
+    QHash<QString, KIconThemeNode *> mReusableNodes;
+    // The themes of a new tree by their names while initIconThemes() builds it, see createThemeNode()
+    QHash<QString, std::shared_ptr<KIconTheme>> mPrefetchedThemes;
+
+    // Theme index of cache entries that don't depend on the theme tree, like absolute paths
+    static constexpr int NoThemeIndex = -1;
+    // Theme index of cache entries that depend on all themes, like fallbacks and unknown icons
+    static constexpr int AllThemesIndex = std::numeric_limits<int>::max();
+
     // This caches rendered QPixmaps in just this process.
     QCache<QString, PixmapWithPath> mPixmapCache;
 
+    // This caches the result of the theme lookup, (name, size, scale) -> path.
+    // It is independent of state, colors and overlays, those only matter for rendering.
+    QCache<QString, IconPathWithTheme> mPathCache;
+
+    // This caches the decoded images before effects are applied, see loadBaseImage().
+    QCache<QString, QImage> mImageCache;
+
+    // This caches emblems at their overlay size, with state effects applied.
+    QCache<QString, QImage> mEmblemCache;
+
+    // The most recently requested icons, they are rendered ahead of a theme switch.
+    QCache<QString, IconRequest> mRecentRequests;
+
+    // The theme switch running in the background, if any, and the groups it was started for
+    std::shared_ptr<KIconLoaderThemeSwitch> mThemeSwitch;
+    QList<int> mThemeSwitchGroups;
+    quint64 mThemeSwitchGeneration = 0;
+
     bool extraDesktopIconsLoaded : 1;
     // lazy loading: initIconThemes() is only needed when the "links" list is needed
     // mIconThemeInited is used inside initIconThemes() to init only once
     bool mIconThemeInited : 1;
     QString m_appname;
 
-    void drawOverlays(const KIconLoader *loader, KIconLoader::Group group, int state, QPixmap &pix, const QStringList &overlays);
+    /*
+     * Paints up to four \a overlays onto the corners of \a image. This is done on the
+     * image before it gets converted to a pixmap, so only one upload is needed.
+     * Returns whether any of the emblems is recolorable.
+     */
+    bool drawOverlays(QImage &image, KIconLoader::Group group, int state, qreal scale, const QStringList &overlays, const KIconColors &colors);
+
+    /*
+     * Returns the emblem \a name at its overlay \a size, from the emblem cache if possible.
+     */
+    QImage loadEmblemImage(const QString &name, KIconLoader::Group group, int size, int state, const KIconColors &colors, bool *recolorable);
+
+    /*
+     * Applies the effects of \a state to \a image.
+     */
+    void applyEffects(QImage &image, KIconLoader::Group group, int state) const;
 
     QHash<QString, QString> mIconAvailability; // icon name -> actual icon name (not null if known to be available)
+    QHash<QString, bool> mRecolorableFiles; // svg path -> whether it has a "current-color-scheme" stylesheet, symbolic png path -> whether it is single-colored
+    // icon name -> the kinds of pixmap cache keys it was rendered with, only those are looked up
+    enum CacheKeyKind : quint8 {
+        KeyWithoutColors = 1,
+        KeyWithColors = 2,
+    };
+    QHash<QString, quint8> mCacheKeyKinds;
+    QHash<QString, KIconCatalog> mIconCatalogs; // results of queryIcons*(), cleared when the theme tree changes
     QElapsedTimer mLastUnknownIconCheck; // recheck for unknown icons after kiconloader_ms_between_checks
     // the colors used to recolor svg icons stylesheets
     KIconColors mColors;
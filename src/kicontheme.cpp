@@ -10,6 +10,7 @@
 */
 
 #include "kicontheme.h"
+#include "kicontheme_p.h"
 
 #include "debug.h"
 
@@ -20,12 +21,19 @@
 
 #include <QAction>
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDebug>
 #include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QHash>
 #include <QMap>
+#include <QMutex>
 #include <QResource>
+#include <QSemaphore>
 #include <QSet>
+#include <QThreadPool>
 #include <QTimer>
 
 #include <private/qguiapplication_p.h>
@@ -33,8 +41,10 @@
 
 #include <qplatformdefs.h>
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <vector>
 
 #include "config.h"
 
@@ -149,7 +159,6 @@ class KIconThemePrivate
 public:
     QString example, screenshot;
     bool hidden;
-    KSharedConfig::Ptr sharedConfig;
 
     struct GroupInfo {
         KIconLoader::Group type;
@@ -174,6 +183,17 @@ public:
     QList<KIconThemeDir *> mScaledDirs;
     bool followsColorScheme : 1;
 
+    // What the theme was created from, see iconThemeIsCurrent()
+    QString mAppName, mBasePathHint, mIndexFile;
+    QStringList mThemeDirs;
+    QStringList mWatchedDirs;
+    QList<QDateTime> mModified; // of mIndexFile followed by mWatchedDirs
+
+    static const KIconThemePrivate *get(const KIconTheme *theme)
+    {
+        return theme->d.get();
+    }
+
     /// Searches the given dirs vector for a matching icon
     QString iconPath(const QList<KIconThemeDir *> &dirs, const QString &name, int size, qreal scale, KIconLoader::MatchType match) const;
 };
@@ -194,6 +214,7 @@ public:
     }
     QString iconPath(const QString &name) const;
     QStringList iconList() const;
+    bool forEachIcon(const std::function<bool(const KIconLoader::IconEntry &)> &callback) const;
     QString constructFileName(const QString &file) const
     {
         return mBaseDir + mThemeDir + QLatin1Char('/') + file;
@@ -334,16 +355,169 @@ QString KIconThemePrivate::iconPath(const QList<KIconThemeDir *> &dirs, const QS
     return path;
 }
 
-KIconTheme::KIconTheme(const QString &name, const QString &appName, const QString &basePathHint)
-    : d(new KIconThemePrivate)
+extern KICONTHEMES_EXPORT int kiconloader_ms_between_checks;
+
+/*
+ * The icon base directories below the generic data locations, together with
+ * the themes inside them. Every theme of an inheritance chain looks itself up
+ * in there, so the directories are listed once and only listed again when the
+ * data locations or the modification time of a base directory change.
+ */
+struct IconBaseDirRegistry {
+    struct Candidate {
+        QString path;
+        QDateTime modified; // invalid if the directory doesn't exist
+        QStringList themes;
+    };
+
+    void rescan(const QStringList &locations);
+    bool isStale() const;
+
+    QMutex mutex;
+    QStringList dataLocations;
+    QList<Candidate> candidates;
+    QElapsedTimer lastCheck;
+    // Bumped whenever the listing may have changed, the shared themes check their files again then
+    quint64 generation = 0;
+};
+
+void IconBaseDirRegistry::rescan(const QStringList &locations)
 {
-    if (name.isEmpty()) {
-        qCWarning(KICONTHEMES) << "KIconTheme created with empty theme name";
-        return;
+    dataLocations = locations;
+    candidates.clear();
+
+    // The missing directories are kept as well, so that their creation is noticed.
+    QStringList paths;
+    for (const QString &location : locations) {
+        paths.append(location + QLatin1String("/icons"));
+    }
+    // These are not in the icon spec, but e.g. GNOME puts some icons there anyway.
+    for (const QString &location : locations) {
+        paths.append(location + QLatin1String("/pixmaps"));
     }
 
-    d->mInternalName = name;
+    for (const QString &path : std::as_const(paths)) {
+        Candidate candidate{path, QDateTime(), QStringList()};
+        const QFileInfo fi(path);
+        if (fi.isDir()) {
+            candidate.modified = fi.lastModified();
+            candidate.themes = QDir(path).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        }
+        candidates.append(candidate);
+    }
+    lastCheck.start();
+    ++generation;
+}
+
+bool IconBaseDirRegistry::isStale() const
+{
+    for (const Candidate &candidate : candidates) {
+        const QFileInfo fi(candidate.path);
+        if ((fi.isDir() ? fi.lastModified() : QDateTime()) != candidate.modified) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Q_GLOBAL_STATIC(IconBaseDirRegistry, s_baseDirRegistry)
+
+QList<IconBaseDir> iconBaseDirs()
+{
+    QList<IconBaseDir> baseDirs;
+
+#ifdef Q_OS_ANDROID
+    // Android icon theme installed by Kirigami
+    const QString androidDir = QStringLiteral("assets:/qml/org/kde/kirigami");
+    if (QFileInfo(androidDir).isDir()) {
+        baseDirs.append({androidDir, QDir(androidDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot)});
+    }
+#endif
+
+    IconBaseDirRegistry *registry = s_baseDirRegistry();
+    {
+        QMutexLocker locker(&registry->mutex);
+        const QStringList locations = QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation);
+        if (locations != registry->dataLocations || !registry->lastCheck.isValid()) {
+            registry->rescan(locations);
+        } else if (registry->lastCheck.elapsed() >= kiconloader_ms_between_checks) {
+            if (registry->isStale()) {
+                registry->rescan(locations);
+            } else {
+                registry->lastCheck.start();
+            }
+        }
+        for (const auto &candidate : std::as_const(registry->candidates)) {
+            if (candidate.modified.isValid()) {
+                baseDirs.append({candidate.path, candidate.themes});
+            }
+        }
+    }
+
+    // local embedded icons, resources can be registered at any time so they are not cached
+    const QString resourceDir = QStringLiteral(":/icons");
+    if (QFileInfo(resourceDir).isDir()) {
+        baseDirs.append({resourceDir, QDir(resourceDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot)});
+    }
+
+    return baseDirs;
+}
+
+void invalidateIconBaseDirs()
+{
+    QMutexLocker locker(&s_baseDirRegistry()->mutex);
+    s_baseDirRegistry()->lastCheck.invalidate();
+    ++s_baseDirRegistry()->generation;
+}
+
+static quint64 iconBaseDirsGeneration()
+{
+    QMutexLocker locker(&s_baseDirRegistry()->mutex);
+    return s_baseDirRegistry()->generation;
+}
 
+/*
+ * Returns the directories of the theme \a name in the icon base directories.
+ * The first one with an index file is stored in \a dir, together with the
+ * \a fileName of the index file and the \a mainSection to read from it.
+ */
+static QStringList findThemeDirs(const QString &name, QString *dir, QString *fileName, QString *mainSection)
+{
+    QStringList themeDirs;
+
+    const QLatin1String indexTheme("index.theme");
+    const QLatin1String indexDesktop("theme.desktop");
+    const QList<IconBaseDir> baseDirs = iconBaseDirs();
+    for (const IconBaseDir &baseDir : baseDirs) {
+        if (!baseDir.themes.contains(name)) {
+            continue;
+        }
+        const QString iconDir = baseDir.path + QLatin1Char('/') + name + QLatin1Char('/');
+        themeDirs.append(iconDir);
+
+        if (dir->isEmpty()) {
+            QString possiblePath;
+            if (possiblePath = iconDir + indexTheme; QFileInfo::exists(possiblePath)) {
+                *dir = iconDir;
+                *fileName = possiblePath;
+                *mainSection = QStringLiteral("Icon Theme");
+            } else if (possiblePath = iconDir + indexDesktop; QFileInfo::exists(possiblePath)) {
+                *dir = iconDir;
+                *fileName = possiblePath;
+                *mainSection = QStringLiteral("KDE Icon Theme");
+            }
+        }
+    }
+
+    return themeDirs;
+}
+
+/*
+ * Returns all directories of the theme \a name, including the application
+ * specific additions to the default themes, see the KIconTheme constructor.
+ */
+static QStringList findAllThemeDirs(const QString &name, const QString &appName, const QString &basePathHint, QString *dir, QString *fileName, QString *mainSection)
+{
     QStringList themeDirs;
 
     // Applications can have local additions to the global "locolor" and
@@ -352,7 +526,7 @@ KIconTheme::KIconTheme(const QString &name, const QString &appName, const QStrin
 
     /* clang-format off */
     if (!appName.isEmpty()
-        && (name == defaultThemeName()
+        && (name == KIconTheme::defaultThemeName()
             || name == QLatin1String("hicolor")
             || name == QLatin1String("locolor"))) { /* clang-format on */
         const QString suffix = QLatin1Char('/') + appName + QLatin1String("/icons/") + name + QLatin1Char('/');
@@ -370,60 +544,203 @@ KIconTheme::KIconTheme(const QString &name, const QString &appName, const QStrin
         }
     }
 
-    // Find the theme description file. These are either locally in the :/icons resource path or global.
-    QStringList icnlibs;
+    themeDirs += findThemeDirs(name, dir, fileName, mainSection);
+    return themeDirs;
+}
 
-#ifdef Q_OS_ANDROID
-    // Android icon theme installed by Kirigami
-    icnlibs << QStringLiteral("assets:/qml/org/kde/kirigami");
-#endif
+QList<int> iconThemeDefaultSizes(const QString &name)
+{
+    QString dir;
+    QString fileName;
+    QString mainSection;
+    findThemeDirs(name, &dir, &fileName, &mainSection);
+    if (fileName.isEmpty()) {
+        return {};
+    }
 
-    // global icons
-    icnlibs += QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QStringLiteral("icons"), QStandardPaths::LocateDirectory);
+    const KConfig config(fileName, KConfig::SimpleConfig);
+    const KConfigGroup cg(&config, mainSection);
+    KIconThemePrivate defaults;
+    QList<int> sizes;
+    sizes.reserve(defaults.m_iconGroups.size());
+    for (const auto &iconGroup : defaults.m_iconGroups) {
+        sizes.append(cg.readEntry(iconGroup.name + QLatin1String("Default"), iconGroup.defaultSize));
+    }
+    return sizes;
+}
 
-    // These are not in the icon spec, but e.g. GNOME puts some icons there anyway.
-    icnlibs += QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QStringLiteral("pixmaps"), QStandardPaths::LocateDirectory);
+namespace
+{
+struct KIconThemeRegistry {
+    struct Entry {
+        // Invalid themes are kept as well, so that themes which are not
+        // installed aren't looked for on every call
+        std::shared_ptr<KIconTheme> theme;
+        // The files of the theme are only checked again when the icon base
+        // directories were invalidated or after kiconloader_ms_between_checks
+        quint64 generation;
+        QElapsedTimer lastCheck;
+    };
 
-    // local embedded icons
-    icnlibs << QStringLiteral(":/icons");
+    QMutex mutex;
+    QHash<QString, Entry> themes;
+};
+}
+Q_GLOBAL_STATIC(KIconThemeRegistry, s_themeRegistry)
 
-    QString fileName;
-    QString mainSection;
-    const QString pathSuffix = QLatin1Char('/') + name + QLatin1Char('/');
-    const QLatin1String indexTheme("index.theme");
-    const QLatin1String indexDesktop("theme.desktop");
-    for (auto &iconDir : icnlibs) {
-        iconDir += pathSuffix;
-        const QFileInfo fi(iconDir);
-        if (!fi.exists() || !fi.isDir()) {
-            continue;
+std::shared_ptr<KIconTheme> sharedIconTheme(const QString &name, const QString &appName, const QString &basePathHint)
+{
+    // The application specific directories are only used for these themes, see the KIconTheme constructor
+    const bool usesAppDirs = !appName.isEmpty() && (name == KIconTheme::defaultThemeName() || name == QLatin1String("hicolor") || name == QLatin1String("locolor"));
+    const QString key = usesAppDirs ? name + QLatin1Char('/') + appName + QLatin1Char('/') + basePathHint : name;
+
+    const quint64 generation = iconBaseDirsGeneration();
+    KIconThemeRegistry *registry = s_themeRegistry();
+    std::shared_ptr<KIconTheme> cached;
+    {
+        QMutexLocker locker(&registry->mutex);
+        const auto it = registry->themes.constFind(key);
+        if (it != registry->themes.constEnd()) {
+            if (it->generation == generation && it->lastCheck.elapsed() < kiconloader_ms_between_checks) {
+                return it->theme;
+            }
+            cached = it->theme;
         }
-        themeDirs.append(iconDir);
+    }
 
-        if (d->mDir.isEmpty()) {
-            QString possiblePath;
-            if (possiblePath = iconDir + indexTheme; QFileInfo::exists(possiblePath)) {
-                d->mDir = iconDir;
-                fileName = possiblePath;
-                mainSection = QStringLiteral("Icon Theme");
-            } else if (possiblePath = iconDir + indexDesktop; QFileInfo::exists(possiblePath)) {
-                d->mDir = iconDir;
-                fileName = possiblePath;
-                mainSection = QStringLiteral("KDE Icon Theme");
+    // Checking the files of the theme doesn't need the lock
+    if (cached && cached->isValid() && iconThemeIsCurrent(cached.get())) {
+        QMutexLocker locker(&registry->mutex);
+        const auto it = registry->themes.find(key);
+        if (it != registry->themes.end() && it->theme == cached) {
+            it->generation = generation;
+            it->lastCheck.start();
+        }
+        return cached;
+    }
+
+    // Construct outside of the lock, other threads may look up other themes meanwhile
+    auto theme = std::make_shared<KIconTheme>(name, usesAppDirs ? appName : QString(), usesAppDirs ? basePathHint : QString());
+
+    QMutexLocker locker(&registry->mutex);
+    const auto it = registry->themes.constFind(key);
+    if (it != registry->themes.constEnd() && it->theme != cached) {
+        // Another thread was faster
+        return it->theme;
+    }
+    KIconThemeRegistry::Entry entry{theme, generation, QElapsedTimer()};
+    entry.lastCheck.start();
+    registry->themes.insert(key, entry);
+    return theme;
+}
+
+QHash<QString, std::shared_ptr<KIconTheme>> prefetchIconThemes(const QStringList &names, const QString &appName)
+{
+    QHash<QString, std::shared_ptr<KIconTheme>> result;
+    QSet<QString> seen;
+    QStringList level;
+    for (const QString &name : names) {
+        if (!seen.contains(name)) {
+            seen.insert(name);
+            level.append(name);
+        }
+    }
+
+    // The themes of one level of the inheritance graph don't depend on each other
+    while (!level.isEmpty()) {
+        // Not a QList, the jobs write to it concurrently and must not detach it
+        std::vector<std::shared_ptr<KIconTheme>> themes(level.size());
+        QSemaphore done;
+        int started = 0;
+        for (int i = 1; i < level.size(); ++i) {
+            auto construct = [&themes, &level, &appName, &done, i]() {
+                themes[i] = sharedIconTheme(level.at(i), appName);
+                done.release();
+            };
+            // Never queue behind other tasks, this may run on a pool thread itself
+            if (QThreadPool::globalInstance()->tryStart(construct)) {
+                ++started;
+            } else {
+                themes[i] = sharedIconTheme(level.at(i), appName);
             }
         }
+        themes[0] = sharedIconTheme(level.at(0), appName);
+        done.acquire(started);
+
+        QStringList nextLevel;
+        for (qsizetype i = 0; i < level.size(); ++i) {
+            const std::shared_ptr<KIconTheme> &theme = themes[i];
+            result.insert(level.at(i), theme);
+            if (!theme->isValid()) {
+                continue;
+            }
+            const QStringList inherited = theme->inherits();
+            for (const QString &name : inherited) {
+                if (!seen.contains(name)) {
+                    seen.insert(name);
+                    nextLevel.append(name);
+                }
+            }
+        }
+        level = nextLevel;
+    }
+    return result;
+}
+
+bool iconThemeIsCurrent(const KIconTheme *theme)
+{
+    const KIconThemePrivate *d = KIconThemePrivate::get(theme);
+    if (d->mDir.isEmpty()) {
+        return false;
+    }
+
+    // New base directories, e.g. from a changed XDG_DATA_DIRS, may add directories to the theme
+    QString dir;
+    QString fileName;
+    QString mainSection;
+    if (findAllThemeDirs(d->mInternalName, d->mAppName, d->mBasePathHint, &dir, &fileName, &mainSection) != d->mThemeDirs || fileName != d->mIndexFile) {
+        return false;
+    }
+
+    QList<QDateTime> modified;
+    modified.reserve(d->mModified.size());
+    modified.append(QFileInfo(fileName).lastModified());
+    for (const QString &watchedDir : d->mWatchedDirs) {
+        modified.append(QFileInfo(watchedDir).lastModified());
+    }
+    return modified == d->mModified;
+}
+
+KIconTheme::KIconTheme(const QString &name, const QString &appName, const QString &basePathHint)
+    : d(new KIconThemePrivate)
+{
+    if (name.isEmpty()) {
+        qCWarning(KICONTHEMES) << "KIconTheme created with empty theme name";
+        return;
     }
 
+    d->mInternalName = name;
+    d->mAppName = appName;
+    d->mBasePathHint = basePathHint;
+
+    QString mainSection;
+    const QStringList themeDirs = findAllThemeDirs(name, appName, basePathHint, &d->mDir, &d->mIndexFile, &mainSection);
+    d->mThemeDirs = themeDirs;
+    const QString &fileName = d->mIndexFile;
+
     if (d->mDir.isEmpty()) {
         qCWarning(KICONTHEMES) << "Icon theme" << name << "not found.";
         return;
     }
 
-    // Use KSharedConfig to avoid parsing the file many times, from each component.
-    // Need to keep a ref to it to make this useful
-    d->sharedConfig = KSharedConfig::openConfig(fileName, KConfig::SimpleConfig);
+    // Taken before reading the file, so that a change while reading is noticed
+    d->mModified.append(QFileInfo(fileName).lastModified());
 
-    KConfigGroup cfg(d->sharedConfig, mainSection);
+    // Not a KSharedConfig, those belong to the thread that opened them while the
+    // theme may be shared with other threads. The themes are shared instead, see sharedIconTheme().
+    const KConfig config(fileName, KConfig::SimpleConfig);
+
+    KConfigGroup cfg(&config, mainSection);
     d->mName = cfg.readEntry("Name");
     d->mDesc = cfg.readEntry("Comment");
     d->mDepth = cfg.readEntry("DisplayDepth", 32);
@@ -447,11 +764,18 @@ KIconTheme::KIconTheme(const QString &name, const QString &appName, const QStrin
     QSet<QString> addedDirs; // Used for avoiding duplicates.
     const QStringList dirs = cfg.readPathEntry("Directories", QStringList()) + cfg.readPathEntry("ScaledDirectories", QStringList());
     for (const auto &dirName : dirs) {
-        KConfigGroup cg(d->sharedConfig, dirName);
+        KConfigGroup cg(&config, dirName);
         for (const auto &themeDir : std::as_const(themeDirs)) {
             const QString currentDir(themeDir + dirName + QLatin1Char('/'));
-            if (!addedDirs.contains(currentDir) && QFileInfo::exists(currentDir)) {
-                addedDirs.insert(currentDir);
+            if (addedDirs.contains(currentDir)) {
+                continue;
+            }
+            addedDirs.insert(currentDir);
+            // Missing directories are watched as well, so that their creation is noticed
+            const QFileInfo info(currentDir);
+            d->mWatchedDirs.append(currentDir);
+            d->mModified.append(info.lastModified());
+            if (info.exists()) {
                 KIconThemeDir *dir = new KIconThemeDir(themeDir, dirName, cg);
                 if (dir->isValid()) {
                     if (dir->scale() > 1) {
@@ -466,7 +790,7 @@ KIconTheme::KIconTheme(const QString &name, const QString &appName, const QStrin
         }
     }
 
-    KConfigGroup cg(d->sharedConfig, mainSection);
+    KConfigGroup cg(&config, mainSection);
     for (auto &iconGroup : d->m_iconGroups) {
         iconGroup.defaultSize = cg.readEntry(iconGroup.name + QLatin1String("Default"), iconGroup.defaultSize);
         iconGroup.availableSizes = cg.readEntry(iconGroup.name + QLatin1String("Sizes"), QList<int>());
@@ -562,20 +886,21 @@ QStringList KIconTheme::queryIcons() const
     return result;
 }
 
+static bool isDirForSize(const KIconThemeDir *dir, int size)
+{
+    const int dirSize = dir->size();
+    return (dir->type() == KIconLoader::Fixed && dirSize == size) //
+        || (dir->type() == KIconLoader::Scalable && size >= dir->minSize() && size <= dir->maxSize())
+        || (dir->type() == KIconLoader::Threshold && abs(size - dirSize) < dir->threshold());
+}
+
 QStringList KIconTheme::queryIcons(int size, KIconLoader::Context context) const
 {
     // Try to find exact match
     QStringList result;
     const QList<KIconThemeDir *> listDirs = d->mDirs + d->mScaledDirs;
     for (const KIconThemeDir *dir : listDirs) {
-        if (!isAnyOrDirContext(dir, context)) {
-            continue;
-        }
-
-        const int dirSize = dir->size();
-        if ((dir->type() == KIconLoader::Fixed && dirSize == size) //
-            || (dir->type() == KIconLoader::Scalable && size >= dir->minSize() && size <= dir->maxSize())
-            || (dir->type() == KIconLoader::Threshold && abs(size - dirSize) < dir->threshold())) {
+        if (isAnyOrDirContext(dir, context) && isDirForSize(dir, size)) {
             result += dir->iconList();
         }
     }
@@ -583,6 +908,28 @@ QStringList KIconTheme::queryIcons(int size, KIconLoader::Context context) const
     return result;
 }
 
+bool KIconTheme::forEachIcon(const std::function<bool(const KIconLoader::IconEntry &)> &callback) const
+{
+    const auto listDirs = d->mDirs + d->mScaledDirs;
+    for (const KIconThemeDir *dir : listDirs) {
+        if (!dir->forEachIcon(callback)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool KIconTheme::forEachIcon(int size, KIconLoader::Context context, const std::function<bool(const KIconLoader::IconEntry &)> &callback) const
+{
+    const auto listDirs = d->mDirs + d->mScaledDirs;
+    for (const KIconThemeDir *dir : listDirs) {
+        if (isAnyOrDirContext(dir, context) && isDirForSize(dir, size) && !dir->forEachIcon(callback)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 QStringList KIconTheme::queryIconsByContext(int size, KIconLoader::Context context) const
 {
     int dw;
@@ -699,6 +1046,80 @@ void KIconTheme::forceThemeForTests(const QString &themeName)
     _theme()->clear(); // ::current sets this again based on conditions
 }
 
+/*
+ * The paths together with their modification times, missing paths have none.
+ */
+static QStringList modificationSignature(const QStringList &paths)
+{
+    QStringList signature;
+    signature.reserve(paths.size());
+    for (const QString &path : paths) {
+        const QFileInfo fi(path);
+        signature += path + QLatin1Char(':') + (fi.exists() ? QString::number(fi.lastModified().toMSecsSinceEpoch()) : QString());
+    }
+    return signature;
+}
+
+/*
+ * Checks whether the theme \a name has a usable icon directory, like
+ * KIconTheme::isValid() but without creating the theme: only the keys needed
+ * are read and the check stops at the first usable directory. Results are
+ * kept in \a cache for as long as the theme directories and the index file
+ * keep their modification time. For invalid themes, the parents of the listed
+ * directories have to keep it as well, creating one of those makes them valid.
+ */
+static bool isIconThemeValid(const QString &name, KConfig *cache)
+{
+    QString dir;
+    QString fileName;
+    QString mainSection;
+    const QStringList themeDirs = findThemeDirs(name, &dir, &fileName, &mainSection);
+    if (fileName.isEmpty()) {
+        return false;
+    }
+
+    const QStringList signature = modificationSignature(themeDirs + QStringList{fileName});
+
+    KConfigGroup cacheGroup(cache, name);
+    const QStringList cachedParentDirs = cacheGroup.readEntry("ParentDirs", QStringList());
+    if (cacheGroup.readEntry("Signature", QStringList()) == signature + modificationSignature(cachedParentDirs)) {
+        return cacheGroup.readEntry("Valid", false);
+    }
+
+    bool valid = false;
+    QStringList parentDirs;
+    const KConfig config(fileName, KConfig::SimpleConfig);
+    const KConfigGroup cfg(&config, mainSection);
+    const QStringList dirs = cfg.readPathEntry("Directories", QStringList()) + cfg.readPathEntry("ScaledDirectories", QStringList());
+    for (const auto &dirName : dirs) {
+        // Check the keys first, they don't need any file system access
+        if (!KIconThemeDir(themeDirs.constFirst(), dirName, KConfigGroup(&config, dirName)).isValid()) {
+            continue;
+        }
+        valid = std::any_of(themeDirs.cbegin(), themeDirs.cend(), [&dirName](const QString &themeDir) {
+            return QFileInfo::exists(themeDir + dirName + QLatin1Char('/'));
+        });
+        if (valid) {
+            break;
+        }
+        // The theme directories themselves are in the signature already
+        for (qsizetype slash = dirName.indexOf(QLatin1Char('/')); slash > 0; slash = dirName.indexOf(QLatin1Char('/'), slash + 1)) {
+            for (const QString &themeDir : themeDirs) {
+                parentDirs += themeDir + dirName.left(slash);
+            }
+        }
+    }
+    if (valid) {
+        parentDirs.clear();
+    }
+    parentDirs.removeDuplicates();
+
+    cacheGroup.writeEntry("Signature", signature + modificationSignature(parentDirs));
+    cacheGroup.writeEntry("ParentDirs", parentDirs);
+    cacheGroup.writeEntry("Valid", valid);
+    return valid;
+}
+
 // static
 QStringList KIconTheme::list()
 {
@@ -707,39 +1128,26 @@ QStringList KIconTheme::list()
         return *_theme_list();
     }
 
-    // Find the theme description file. These are either locally in the :/icons resource path or global.
-    QStringList icnlibs;
-
-    // global icons
-    icnlibs += QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QStringLiteral("icons"), QStandardPaths::LocateDirectory);
+    KConfig cache(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/kiconthemes_list"), KConfig::SimpleConfig);
 
-    // These are not in the icon spec, but e.g. GNOME puts some icons there anyway.
-    icnlibs += QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QStringLiteral("pixmaps"), QStandardPaths::LocateDirectory);
-
-    // local embedded icons
-    icnlibs << QStringLiteral(":/icons");
-
-    for (const QString &iconDir : std::as_const(icnlibs)) {
-        QDir dir(iconDir);
-        const QStringList themeDirs = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-        for (const auto &theme : themeDirs) {
-            if (theme.startsWith(QLatin1String("default."))) {
+    const QList<IconBaseDir> baseDirs = iconBaseDirs();
+    for (const IconBaseDir &baseDir : baseDirs) {
+        for (const auto &theme : baseDir.themes) {
+            if (theme.startsWith(QLatin1String("default.")) || _theme_list()->contains(theme)) {
                 continue;
             }
 
-            const QString prefix = iconDir + QLatin1Char('/') + theme;
+            const QString prefix = baseDir.path + QLatin1Char('/') + theme;
             if (!QFileInfo::exists(prefix + QLatin1String("/index.desktop")) //
                 && !QFileInfo::exists(prefix + QLatin1String("/index.theme"))) {
                 continue;
             }
 
-            if (!KIconTheme(theme).isValid()) {
+            if (!isIconThemeValid(theme, &cache)) {
                 continue;
             }
 
-            if (!_theme_list()->contains(theme)) {
-                _theme_list()->append(theme);
-            }
+            _theme_list()->append(theme);
         }
     }
     return *_theme_list();
@@ -750,6 +1158,10 @@ void KIconTheme::reconfigure()
 {
     _theme()->clear();
     _theme_list()->clear();
+
+    // Loaders keep using the themes they have until they are reconfigured themselves.
+    // The shared themes check their files again, unchanged ones stay shared.
+    invalidateIconBaseDirs();
 }
 
 // static
@@ -839,12 +1251,16 @@ QString KIconThemeDir::iconPath(const QString &name) const
     return QString();
 }
 
+static QStringList iconFileFormats()
+{
+    return QStringList() << QStringLiteral("*.png") << QStringLiteral("*.svg") << QStringLiteral("*.svgz") << QStringLiteral("*.xpm");
+}
+
 QStringList KIconThemeDir::iconList() const
 {
     const QDir icondir = constructFileName(QString());
 
-    const QStringList formats = QStringList() << QStringLiteral("*.png") << QStringLiteral("*.svg") << QStringLiteral("*.svgz") << QStringLiteral("*.xpm");
-    const QStringList lst = icondir.entryList(formats, QDir::Files);
+    const QStringList lst = icondir.entryList(iconFileFormats(), QDir::Files);
 
     QStringList result;
     result.reserve(lst.size());
@@ -853,3 +1269,20 @@ QStringList KIconThemeDir::iconList() const
     }
     return result;
 }
+
+bool KIconThemeDir::forEachIcon(const std::function<bool(const KIconLoader::IconEntry &)> &callback) const
+{
+    // Unlike QDir::entryList() this doesn't need the whole directory before returning the first entry
+    QDirIterator it(constructFileName(QString()), iconFileFormats(), QDir::Files);
+    KIconLoader::IconEntry entry{QString(), QString(), mSize, mContext};
+    while (it.hasNext()) {
+        it.next();
+        const QString file = it.fileName();
+        entry.name = file.left(file.lastIndexOf(QLatin1Char('.')));
+        entry.path = constructFileName(file);
+        if (!callback(entry)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -173,6 +173,28 @@ public:
      */
     QStringList queryIconsByContext(int size, KIconLoader::Context context = KIconLoader::Any) const;
 
+    /*!
+     * Calls \a callback for every icon of the theme, directory by directory,
+     * as the directories are read. Unlike queryIcons() an icon that is in
+     * several directories is reported for each of them.
+     *
+     * Returns \c false if \a callback stopped the enumeration by returning \c false.
+     *
+     * \since 6.30
+     */
+    bool forEachIcon(const std::function<bool(const KIconLoader::IconEntry &)> &callback) const;
+
+    /*!
+     * Calls \a callback for every icon of the theme matching \a size and
+     * \a context, like queryIcons(int, KIconLoader::Context) but as the
+     * directories are read.
+     *
+     * Returns \c false if \a callback stopped the enumeration by returning \c false.
+     *
+     * \since 6.30
+     */
+    bool forEachIcon(int size, KIconLoader::Context context, const std::function<bool(const KIconLoader::IconEntry &)> &callback) const;
+
     /*!
      * Lookup an icon in the theme.
      *
@@ -330,6 +352,7 @@ public:
     static void initTheme();
 
 private:
+    friend class KIconThemePrivate;
     std::unique_ptr<class KIconThemePrivate> const d;
 };
 
@@ -0,0 +1,77 @@
+/*
+    This file is part of the KDE project, module kdecore.
+    SPDX-FileCopyrightText: 2000 Geert Jansen <jansen@kde.org>
+    SPDX-FileCopyrightText: 2000 Antonio Larrosa <larrosa@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#ifndef KICONTHEME_P_H
+#define KICONTHEME_P_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+
+class KIconTheme;
+
+struct IconBaseDir {
+    QString path;
+    QStringList themes; // names of the subdirectories
+};
+
+/*
+ * Returns the icon base directories in lookup order: the icons and pixmaps
+ * directories of the generic data locations, then the :/icons resource path.
+ * The listing is shared by the whole process and only repeated when a data
+ * location or a base directory changed, checked at most every
+ * kiconloader_ms_between_checks.
+ */
+QList<IconBaseDir> iconBaseDirs();
+
+/*
+ * Makes the next iconBaseDirs() check the base directories for changes.
+ */
+void invalidateIconBaseDirs();
+
+/*
+ * Returns the default size of each KIconLoader::Group for the theme \a name,
+ * reading only the main section of its index file. Unlike creating a KIconTheme
+ * this doesn't look into the directories of the theme.
+ * Returns an empty list if there is no index file for the theme.
+ */
+QList<int> iconThemeDefaultSizes(const QString &name);
+
+/*
+ * Returns the KIconTheme for these arguments from a registry shared by all
+ * loaders of the process, creating it if needed. Themes are not modified after
+ * their construction, so they can be used from any thread. A theme whose files
+ * changed is created anew, see iconThemeIsCurrent(). The files are only checked
+ * again after invalidateIconBaseDirs(), which KIconTheme::reconfigure() and
+ * KIconLoader::reconfigure() call, or after kiconloader_ms_between_checks.
+ * Invalid themes are kept as well and checked in the same way.
+ */
+std::shared_ptr<KIconTheme> sharedIconTheme(const QString &name, const QString &appName = QString(), const QString &basePathHint = QString());
+
+/*
+ * Creates the themes \a names and all themes they inherit in the registry of
+ * sharedIconTheme(). The themes of each level of the inheritance graph are
+ * constructed concurrently, reading their index files and probing their
+ * directories in parallel. Returns the themes by their names, including the
+ * invalid ones.
+ */
+QHash<QString, std::shared_ptr<KIconTheme>> prefetchIconThemes(const QStringList &names, const QString &appName);
+
+/*
+ * Returns whether \a theme still matches its files. A KIconTheme only reads
+ * its index file and looks for its directories when it is created, so it is
+ * outdated once the index file, the set of theme directories in the icon base
+ * directories or the modification time of one of its directories changed.
+ * The latter also covers icons installed into an existing directory.
+ */
+bool iconThemeIsCurrent(const KIconTheme *theme);
+
+#endif
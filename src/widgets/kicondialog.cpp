@@ -152,29 +152,19 @@ bool KIconDialogModel::hasSymbolicIcon() const
     return m_hasSymbolicIcon;
 }
 
-void KIconDialogModel::load(const QStringList &paths)
+void KIconDialogModel::load(const KIconCatalog &catalog)
 {
     beginResetModel();
 
     const bool oldSymbolic = m_hasSymbolicIcon;
     m_hasSymbolicIcon = false;
 
-    m_data.clear();
-    m_data.reserve(paths.count());
+    m_catalog = catalog;
+    m_pixmaps.clear();
+    m_names.clear();
 
-    for (const QString &path : paths) {
-        const QFileInfo fi(path);
-
-        KIconDialogModelData item;
-        item.name = fi.completeBaseName();
-        item.path = path;
-        // pixmap is created on demand
-
-        if (!m_hasSymbolicIcon && item.name.endsWith(symbolicSuffix())) {
-            m_hasSymbolicIcon = true;
-        }
-
-        m_data.append(item);
+    for (qsizetype i = 0; i < m_catalog.size() && !m_hasSymbolicIcon; ++i) {
+        m_hasSymbolicIcon = m_catalog.name(i).endsWith(symbolicSuffix());
     }
 
     endResetModel();
@@ -189,7 +179,7 @@ int KIconDialogModel::rowCount(const QModelIndex &parent) const
     if (parent.isValid()) {
         return 0;
     }
-    return m_data.count();
+    return m_catalog.size();
 }
 
 QVariant KIconDialogModel::data(const QModelIndex &index, int role) const
@@ -198,36 +188,44 @@ QVariant KIconDialogModel::data(const QModelIndex &index, int role) const
         return QVariant();
     }
 
-    const auto &item = m_data.at(index.row());
+    const int row = index.row();
 
     switch (role) {
     case Qt::DisplayRole:
-        return item.name;
+        return name(row);
     case Qt::DecorationRole:
-        if (item.pixmap.isNull()) {
+        if (!m_pixmaps.contains(row)) {
             const_cast<KIconDialogModel *>(this)->loadPixmap(index);
         }
-        return item.pixmap;
+        return m_pixmaps.value(row);
     case Qt::ToolTipRole:
-        return item.name;
+        return name(row);
     case PathRole:
-        return item.path;
+        return m_catalog.path(row);
     }
 
     return QVariant();
 }
 
+QString KIconDialogModel::name(int row) const
+{
+    auto it = m_names.constFind(row);
+    if (it == m_names.constEnd()) {
+        it = m_names.insert(row, m_catalog.name(row).toString());
+    }
+    return it.value();
+}
+
 void KIconDialogModel::loadPixmap(const QModelIndex &index)
 {
     Q_ASSERT(index.isValid());
-
-    auto &item = m_data[index.row()];
-    Q_ASSERT(item.pixmap.isNull());
+    Q_ASSERT(!m_pixmaps.contains(index.row()));
 
     const auto dpr = devicePixelRatio();
 
-    item.pixmap = m_loader->loadScaledIcon(item.path, KIconLoader::Desktop, dpr, iconSize(), KIconLoader::DefaultState, {}, nullptr, true);
-    item.pixmap.setDevicePixelRatio(dpr);
+    QPixmap pixmap = m_loader->loadScaledIcon(m_catalog.path(index.row()), KIconLoader::Desktop, dpr, iconSize(), KIconLoader::DefaultState, {}, nullptr, true);
+    pixmap.setDevicePixelRatio(dpr);
+    m_pixmaps.insert(index.row(), pixmap);
 }
 
 /*
@@ -467,39 +465,42 @@ void KIconDialogPrivate::init()
 
 KIconDialog::~KIconDialog() = default;
 
-static bool sortByFileName(const QString &path1, const QString &path2)
-{
-    const QString fileName1 = path1.mid(path1.lastIndexOf(QLatin1Char('/')) + 1);
-    const QString fileName2 = path2.mid(path2.lastIndexOf(QLatin1Char('/')) + 1);
-    return QString::compare(fileName1, fileName2, Qt::CaseInsensitive) < 0;
-}
-
 void KIconDialogPrivate::showIcons()
 {
-    QStringList filelist;
+    KIconCatalog catalog;
+    auto appendAll = [&catalog](const QStringList &paths) {
+        catalog.reserve(paths.size());
+        for (const QString &path : paths) {
+            catalog.append(path);
+        }
+    };
     if (isSystemIconsContext()) {
         if (m_bStrictIconSize) {
-            filelist = mpLoader->queryIcons(mGroupOrSize, mContext);
+            mpLoader->forEachIcon(mGroupOrSize, mContext, [&catalog](const KIconLoader::IconEntry &entry) {
+                catalog.append(entry.path);
+                return true;
+            });
         } else {
-            filelist = mpLoader->queryIconsByContext(mGroupOrSize, mContext);
+            appendAll(mpLoader->queryIconsByContext(mGroupOrSize, mContext));
         }
     } else if (!customLocation.isEmpty()) {
-        filelist = mpLoader->queryIconsByDir(customLocation);
+        appendAll(mpLoader->queryIconsByDir(customLocation));
     } else {
         // List PNG files found directly in the kiconload search paths.
         const QStringList pngNameFilter(QStringLiteral("*.png"));
         for (const QString &relDir : KIconLoader::global()->searchPaths()) {
             const QStringList dirs = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, relDir, QStandardPaths::LocateDirectory);
             for (const QString &dir : dirs) {
+                const QString dirPrefix = dir + QLatin1Char('/');
                 const auto files = QDir(dir).entryList(pngNameFilter);
                 for (const QString &fileName : files) {
-                    filelist << dir + QLatin1Char('/') + fileName;
+                    catalog.append(dirPrefix, fileName);
                 }
             }
         }
     }
 
-    std::sort(filelist.begin(), filelist.end(), sortByFileName);
+    catalog.sortByFileName();
 
     // The KIconCanvas has uniformItemSizes set which really expects
     // all added icons to be the same size, otherwise weirdness ensues :)
@@ -539,7 +540,7 @@ void KIconDialogPrivate::showIcons()
 
     model->setIconSize(ui.canvas->iconSize());
     model->setDevicePixelRatio(q->devicePixelRatioF());
-    model->load(filelist);
+    model->load(catalog);
 
     if (!pendingSelectedIcon.isEmpty()) {
         selectIcon(pendingSelectedIcon);
@@ -8,20 +8,14 @@
 #define KICONDIALOGMODEL_P_H
 
 #include <QAbstractListModel>
-#include <QList>
+#include <QHash>
 #include <QPixmap>
 #include <QSize>
 #include <QString>
-#include <QStringList>
 
-class KIconLoader;
+#include <kiconcatalog_p.h>
 
-struct KIconDialogModelData {
-    QString name;
-    QString path;
-    QPixmap pixmap;
-};
-Q_DECLARE_TYPEINFO(KIconDialogModelData, Q_RELOCATABLE_TYPE);
+class KIconLoader;
 
 class KIconDialogModel : public QAbstractListModel
 {
@@ -42,7 +36,7 @@ public:
     static QLatin1String symbolicSuffix();
     bool hasSymbolicIcon() const;
 
-    void load(const QStringList &paths);
+    void load(const KIconCatalog &catalog);
 
     int rowCount(const QModelIndex &parent) const override;
     QVariant data(const QModelIndex &index, int role) const override;
@@ -52,8 +46,11 @@ Q_SIGNALS:
 
 private:
     void loadPixmap(const QModelIndex &index);
+    QString name(int row) const;
 
-    QList<KIconDialogModelData> m_data;
+    KIconCatalog m_catalog;
+    QHash<int, QPixmap> m_pixmaps; // row -> pixmap, created on demand
+    mutable QHash<int, QString> m_names; // row -> name, created on demand and shared with the views
 
     KIconLoader *m_loader;
     qreal m_dpr = 1;